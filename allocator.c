@@ -0,0 +1,113 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "allocator.h"
+
+// --- Default Allocator ---
+static void* default_allocate(void* user, size_t size, AllocTag tag) {
+    (void)user; (void)tag;
+    return malloc(size);
+}
+
+static void* default_reallocate(void* user, void* ptr, size_t old_size, size_t new_size, AllocTag tag) {
+    (void)user; (void)old_size; (void)tag;
+    return realloc(ptr, new_size);
+}
+
+static void default_release(void* user, void* ptr, size_t size, AllocTag tag) {
+    (void)user; (void)size; (void)tag;
+    free(ptr);
+}
+
+static Allocator default_allocator = { default_allocate, default_reallocate, default_release, NULL, {0}, {0}, {0}, {0}, 0, 0 };
+
+Allocator* allocator_default(void) {
+    return &default_allocator;
+}
+
+void allocator_init(Allocator* allocator,
+                    void* (*allocate)(void* user, size_t size, AllocTag tag),
+                    void* (*reallocate)(void* user, void* ptr, size_t old_size, size_t new_size, AllocTag tag),
+                    void (*release)(void* user, void* ptr, size_t size, AllocTag tag),
+                    void* user) {
+    memset(allocator, 0, sizeof(*allocator));
+    allocator->allocate = allocate;
+    allocator->reallocate = reallocate;
+    allocator->release = release;
+    allocator->user = user;
+}
+
+// --- Accounting ---
+static void out_of_memory(size_t size, AllocTag tag) {
+    fprintf(stderr, "Out of memory: %zu bytes for %s\n", size, allocator_tag_name(tag));
+    exit(EXIT_FAILURE);
+}
+
+static void raise_peak(size_t* peak_bytes, size_t live) {
+    size_t peak = __atomic_load_n(peak_bytes, __ATOMIC_RELAXED);
+    while (live > peak && !__atomic_compare_exchange_n(peak_bytes, &peak, live, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {}
+}
+
+// prun のワーカーが並行して割り当てるのでアトミックに数える
+static void account(Allocator* allocator, AllocTag tag, size_t added, size_t removed) {
+    raise_peak(&allocator->peak[tag], __atomic_add_fetch(&allocator->live[tag], added - removed, __ATOMIC_RELAXED));
+    raise_peak(&allocator->peak_total, __atomic_add_fetch(&allocator->live_total, added - removed, __ATOMIC_RELAXED));
+}
+
+void* allocator_alloc(Allocator* allocator, size_t size, AllocTag tag) {
+    void* ptr = allocator->allocate(allocator->user, size, tag);
+    if (!ptr) out_of_memory(size, tag);
+    __atomic_fetch_add(&allocator->allocations[tag], 1, __ATOMIC_RELAXED);
+    account(allocator, tag, size, 0);
+    return ptr;
+}
+
+void* allocator_calloc(Allocator* allocator, size_t count, size_t size, AllocTag tag) {
+    void* ptr = allocator_alloc(allocator, count * size, tag);
+    memset(ptr, 0, count * size);
+    return ptr;
+}
+
+void* allocator_realloc(Allocator* allocator, void* ptr, size_t old_size, size_t new_size, AllocTag tag) {
+    if (!ptr) return allocator_alloc(allocator, new_size, tag);
+    void* grown = allocator->reallocate(allocator->user, ptr, old_size, new_size, tag);
+    if (!grown) out_of_memory(new_size, tag);
+    account(allocator, tag, new_size, old_size);
+    return grown;
+}
+
+void allocator_free(Allocator* allocator, void* ptr, size_t size, AllocTag tag) {
+    if (!ptr) return;
+    allocator->release(allocator->user, ptr, size, tag);
+    __atomic_fetch_add(&allocator->releases[tag], 1, __ATOMIC_RELAXED);
+    account(allocator, tag, 0, size);
+}
+
+char* allocator_strdup(Allocator* allocator, const char* s, AllocTag tag) {
+    size_t size = strlen(s) + 1;
+    char* copy = allocator_alloc(allocator, size, tag);
+    memcpy(copy, s, size);
+    return copy;
+}
+
+void allocator_free_string(Allocator* allocator, char* s, AllocTag tag) {
+    if (s) allocator_free(allocator, s, strlen(s) + 1, tag);
+}
+
+// --- Report ---
+const char* allocator_tag_name(AllocTag tag) {
+    static const char* names[ALLOC_TAG_COUNT] = { "tokens", "ast", "variables", "strings", "categories", "code" };
+    return tag < ALLOC_TAG_COUNT ? names[tag] : "?";
+}
+
+void allocator_report(const Allocator* allocator, FILE* out) {
+    size_t allocations = 0, releases = 0;
+    fprintf(out, "  %-12s %12s %12s %14s %14s\n", "allocator", "allocs", "frees", "live bytes", "peak bytes");
+    for (int tag = 0; tag < ALLOC_TAG_COUNT; tag++) {
+        fprintf(out, "  %-12s %12zu %12zu %14zu %14zu\n", allocator_tag_name((AllocTag)tag),
+                allocator->allocations[tag], allocator->releases[tag], allocator->live[tag], allocator->peak[tag]);
+        allocations += allocator->allocations[tag];
+        releases += allocator->releases[tag];
+    }
+    fprintf(out, "  %-12s %12zu %12zu %14zu %14zu\n", "total", allocations, releases, allocator->live_total, allocator->peak_total);
+}
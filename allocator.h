@@ -0,0 +1,53 @@
+#ifndef ALLOCATOR_H
+#define ALLOCATOR_H
+
+#include <stdio.h>
+#include <stddef.h>
+
+// 割り当ての用途。用途ごとに使用中・最大のバイト数を数える
+typedef enum {
+    ALLOC_TOKENS,       // 字句解析器とトークン列
+    ALLOC_AST,          // パーサと AST のアリーナ
+    ALLOC_VARIABLES,    // 変数表・記号表・型推論の結果
+    ALLOC_STRINGS,      // RString
+    ALLOC_CATEGORIES,   // カテゴリ表
+    ALLOC_CODE,         // バイトコードと VM のレジスタ
+    ALLOC_TAG_COUNT
+} AllocTag;
+
+// 割り当て関数の表。lexer_create / parser_create / interpreter_create に渡すと、
+// そこから作られるものの割り当てはすべてこれを通る。組み込み側は独自のプールや上限を差し込める。
+// 解放と伸縮には割り当てたときの大きさを渡す。NULL を返すとメモリ不足として終了する
+typedef struct Allocator {
+    void* (*allocate)(void* user, size_t size, AllocTag tag);
+    void* (*reallocate)(void* user, void* ptr, size_t old_size, size_t new_size, AllocTag tag);
+    void (*release)(void* user, void* ptr, size_t size, AllocTag tag);
+    void* user;
+    // allocator_* が更新する
+    size_t live[ALLOC_TAG_COUNT];
+    size_t peak[ALLOC_TAG_COUNT];
+    size_t allocations[ALLOC_TAG_COUNT];    // allocate の回数（realloc(NULL) を含む。伸縮は数えない）
+    size_t releases[ALLOC_TAG_COUNT];
+    size_t live_total;                      // 全用途の合計
+    size_t peak_total;
+} Allocator;
+
+// malloc / realloc / free を使う既定のアロケータ（プロセスで1つ）
+Allocator* allocator_default(void);
+void allocator_init(Allocator* allocator,
+                    void* (*allocate)(void* user, size_t size, AllocTag tag),
+                    void* (*reallocate)(void* user, void* ptr, size_t old_size, size_t new_size, AllocTag tag),
+                    void (*release)(void* user, void* ptr, size_t size, AllocTag tag),
+                    void* user);
+
+void* allocator_alloc(Allocator* allocator, size_t size, AllocTag tag);
+void* allocator_calloc(Allocator* allocator, size_t count, size_t size, AllocTag tag);
+void* allocator_realloc(Allocator* allocator, void* ptr, size_t old_size, size_t new_size, AllocTag tag);
+void allocator_free(Allocator* allocator, void* ptr, size_t size, AllocTag tag);
+char* allocator_strdup(Allocator* allocator, const char* s, AllocTag tag);
+void allocator_free_string(Allocator* allocator, char* s, AllocTag tag);    // allocator_strdup したもの
+
+const char* allocator_tag_name(AllocTag tag);
+void allocator_report(const Allocator* allocator, FILE* out);
+
+#endif
@@ -0,0 +1,132 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "arena.h"
+
+#define ARENA_BLOCK_SIZE (64 * 1024)
+#define ARENA_ALIGN 16
+
+static size_t align_up(size_t n) {
+    return (n + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+}
+
+// ブロックヘッダの直後からデータ領域
+static char* block_data(ArenaBlock* block) {
+    return (char*)block + align_up(sizeof(ArenaBlock));
+}
+
+static size_t block_bytes(size_t size) {
+    return align_up(sizeof(ArenaBlock)) + size;
+}
+
+static ArenaBlock* block_create(Arena* arena, size_t size) {
+    ArenaBlock* block = allocator_alloc(arena->allocator, block_bytes(size), arena->tag);
+    block->next = NULL;
+    block->size = size;
+    block->used = 0;
+    return block;
+}
+
+static void block_free(Arena* arena, ArenaBlock* block) {
+    allocator_free(arena->allocator, block, block_bytes(block->size), arena->tag);
+}
+
+void arena_init(Arena* arena, Allocator* allocator, AllocTag tag) {
+    arena->allocator = allocator;
+    arena->tag = tag;
+    arena->head = NULL;
+    arena->bytes_used = 0;
+    arena->bytes_reserved = 0;
+    arena->last = NULL;
+    arena->cleanups = NULL;
+}
+
+// 登録と逆順に呼ぶ
+static void arena_run_cleanups(Arena* arena) {
+    for (ArenaCleanup* cleanup = arena->cleanups; cleanup; cleanup = cleanup->next)
+        cleanup->fn(cleanup->ptr);
+    arena->cleanups = NULL;
+}
+
+void arena_defer(Arena* arena, void (*fn)(void*), void* ptr) {
+    ArenaCleanup* cleanup = arena_alloc(arena, sizeof(ArenaCleanup));
+    cleanup->fn = fn;
+    cleanup->ptr = ptr;
+    cleanup->next = arena->cleanups;
+    arena->cleanups = cleanup;
+}
+
+void arena_free(Arena* arena) {
+    arena_run_cleanups(arena);
+    ArenaBlock* block = arena->head;
+    while (block) {
+        ArenaBlock* next = block->next;
+        block_free(arena, block);
+        block = next;
+    }
+    arena_init(arena, arena->allocator, arena->tag);
+}
+
+// 最初に確保した（最も古い）ブロックだけ残して空にする
+void arena_reset(Arena* arena) {
+    arena_run_cleanups(arena);
+    ArenaBlock* block = arena->head;
+    if (!block) return;
+    while (block->next) {
+        ArenaBlock* next = block->next;
+        block_free(arena, block);
+        block = next;
+    }
+    block->used = 0;
+    arena->head = block;
+    arena->bytes_used = 0;
+    arena->bytes_reserved = block->size;
+    arena->last = NULL;
+}
+
+void* arena_alloc(Arena* arena, size_t size) {
+    size = align_up(size ? size : 1);
+    ArenaBlock* block = arena->head;
+    if (!block || block->used + size > block->size) {
+        block = block_create(arena, size > ARENA_BLOCK_SIZE ? size : ARENA_BLOCK_SIZE);
+        block->next = arena->head;
+        arena->head = block;
+        arena->bytes_reserved += block->size;
+    }
+    void* ptr = block_data(block) + block->used;
+    block->used += size;
+    arena->bytes_used += size;
+    arena->last = ptr;
+    return ptr;
+}
+
+// 直前の割り当てならその場で伸ばし、そうでなければ新しい領域へコピーする
+void* arena_grow(Arena* arena, void* ptr, size_t old_size, size_t new_size) {
+    if (!ptr) return arena_alloc(arena, new_size);
+    ArenaBlock* block = arena->head;
+    if (ptr == arena->last && block) {
+        size_t offset = (size_t)((char*)ptr - block_data(block));
+        size_t aligned = align_up(new_size);
+        if (offset + aligned <= block->size) {
+            arena->bytes_used += aligned - (block->used - offset);
+            block->used = offset + aligned;
+            return ptr;
+        }
+    }
+    void* new_ptr = arena_alloc(arena, new_size);
+    memcpy(new_ptr, ptr, old_size < new_size ? old_size : new_size);
+    return new_ptr;
+}
+
+char* arena_strndup(Arena* arena, const char* s, size_t n) {
+    size_t len = 0;
+    while (len < n && s[len] != '\0') len++;
+    char* copy = arena_alloc(arena, len + 1);
+    memcpy(copy, s, len);
+    copy[len] = '\0';
+    return copy;
+}
+
+char* arena_strdup(Arena* arena, const char* s) {
+    return arena_strndup(arena, s, strlen(s));
+}
@@ -0,0 +1,40 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+#include "allocator.h"
+
+// 領域（リージョン）アロケータ。個別の解放はせず、arena_reset() でまとめて解放する
+typedef struct ArenaBlock {
+    struct ArenaBlock* next;
+    size_t size;
+    size_t used;
+} ArenaBlock;
+
+// アリーナの解放時に呼ぶ後始末（アリーナ外の資源を持つノード用）
+typedef struct ArenaCleanup {
+    struct ArenaCleanup* next;
+    void (*fn)(void*);
+    void* ptr;
+} ArenaCleanup;
+
+typedef struct {
+    ArenaBlock* head;       // 現在割り当て中のブロック
+    size_t bytes_used;      // 割り当て済みバイト数（アラインメント込み）
+    size_t bytes_reserved;  // ブロックとして確保済みのバイト数
+    void* last;             // 直前の割り当て（arena_grow の伸長用）
+    ArenaCleanup* cleanups;
+    Allocator* allocator;   // ブロックの割り当て先
+    AllocTag tag;
+} Arena;
+
+void arena_init(Arena* arena, Allocator* allocator, AllocTag tag);
+void arena_free(Arena* arena);
+void arena_reset(Arena* arena);
+void* arena_alloc(Arena* arena, size_t size);
+void* arena_grow(Arena* arena, void* ptr, size_t old_size, size_t new_size);
+char* arena_strndup(Arena* arena, const char* s, size_t n);
+char* arena_strdup(Arena* arena, const char* s);
+void arena_defer(Arena* arena, void (*fn)(void*), void* ptr);
+
+#endif
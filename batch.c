@@ -0,0 +1,400 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include "batch.h"
+#include "source.h"
+#include "parser.h"
+#include "interpreter.h"
+#include "resolver.h"
+#include "optimizer.h"
+#include "inference.h"
+#include "compiler.h"
+#include "vm.h"
+#include "cache.h"
+#include "parallel.h"
+#include "stats.h"
+
+#ifdef _WIN32
+#include <direct.h>
+#define make_directory(path) _mkdir(path)
+#else
+#include <pthread.h>
+#define make_directory(path) mkdir(path, 0777)
+#endif
+
+#define BATCH_PATH_MAX 4096
+#define WORKER_STACK_SIZE (8 * 1024 * 1024)   // parallel.c と同じく run の深い再帰に備える
+
+typedef enum { BATCH_OK, BATCH_READ_FAILED, BATCH_PARSE_FAILED, BATCH_ERROR, BATCH_OUTPUT_FAILED } BatchStatus;
+
+static const char* status_names[] = { "ok", "read failed", "parse failed", "error", "output failed" };
+
+typedef struct {
+    char* path;
+    long long size;     // 大きいスクリプトから配る
+    double seconds;
+    BatchStatus status;
+} BatchJob;
+
+// --- Script List ---
+typedef struct {
+    BatchJob* jobs;
+    int count;
+    int capacity;
+} JobList;
+
+static void job_list_add(JobList* list, const char* path) {
+    if (list->count == list->capacity) {
+        list->capacity = list->capacity ? list->capacity * 2 : 64;
+        list->jobs = realloc(list->jobs, sizeof(BatchJob) * (size_t)list->capacity);
+        if (!list->jobs) { perror("realloc failed"); exit(EXIT_FAILURE); }
+    }
+    BatchJob* job = &list->jobs[list->count++];
+    size_t length = strlen(path);
+    job->path = malloc(length + 1);
+    if (!job->path) { perror("malloc failed"); exit(EXIT_FAILURE); }
+    memcpy(job->path, path, length + 1);
+    struct stat st;
+    job->size = stat(path, &st) == 0 ? (long long)st.st_size : 0;
+    job->seconds = 0;
+    job->status = BATCH_OK;
+}
+
+static void job_list_free(JobList* list) {
+    for (int i = 0; i < list->count; i++) free(list->jobs[i].path);
+    free(list->jobs);
+}
+
+static int has_suffix(const char* name, const char* suffix) {
+    size_t length = strlen(name), suffix_length = strlen(suffix);
+    return length > suffix_length && strcmp(name + length - suffix_length, suffix) == 0;
+}
+
+static int compare_paths(const void* a, const void* b) {
+    return strcmp(((const BatchJob*)a)->path, ((const BatchJob*)b)->path);
+}
+
+// ディレクトリ直下の *.str を名前順に並べる
+static void list_directory(JobList* list, DIR* dir, const char* path) {
+    struct dirent* entry;
+    char script[BATCH_PATH_MAX];
+    while ((entry = readdir(dir)) != NULL) {
+        if (!has_suffix(entry->d_name, ".str")) continue;
+        int n = snprintf(script, sizeof(script), "%s/%s", path, entry->d_name);
+        if (n > 0 && (size_t)n < sizeof(script)) job_list_add(list, script);
+    }
+    closedir(dir);
+    qsort(list->jobs, (size_t)list->count, sizeof(BatchJob), compare_paths);
+}
+
+static int is_separator(char c) {
+#ifdef _WIN32
+    if (c == '\\') return 1;
+#endif
+    return c == '/';
+}
+
+static int is_absolute(const char* path) {
+#ifdef _WIN32
+    if (path[0] && path[1] == ':') return 1;
+#endif
+    return is_separator(path[0]);
+}
+
+// 1行に1つのパス。空行と '#' で始まる行は飛ばす。相対パスはリストのあるディレクトリから辿る
+static int list_file(JobList* list, const char* path) {
+    FILE* file = fopen(path, "r");
+    if (!file) { perror("Error opening batch list"); return 0; }
+    int directory_length = 0;
+    for (int i = 0; path[i]; i++)
+        if (is_separator(path[i])) directory_length = i + 1;
+    char line[BATCH_PATH_MAX], script[BATCH_PATH_MAX];
+    while (fgets(line, sizeof(line), file)) {
+        line[strcspn(line, "\r\n")] = '\0';
+        if (line[0] == '\0' || line[0] == '#') continue;
+        if (is_absolute(line)) { job_list_add(list, line); continue; }
+        int n = snprintf(script, sizeof(script), "%.*s%s", directory_length, path, line);
+        if (n > 0 && (size_t)n < sizeof(script)) job_list_add(list, script);
+    }
+    fclose(file);
+    return 1;
+}
+
+// --- Running One Script ---
+// エラーの出力先。件数を数えてから出力ファイルへ書く
+typedef struct {
+    FILE* file;
+    int count;
+} ErrorCounter;
+
+static void count_error(void* context, const char* data, size_t length) {
+    ErrorCounter* errors = context;
+    errors->count++;
+    fwrite(data, 1, length, errors->file);
+}
+
+// foo/bar.str -> <output_dir>/bar.out（output_dir が NULL なら foo/bar.out）
+static int output_file_path(char* buffer, size_t size, const char* script, const char* output_dir) {
+    size_t stem = has_suffix(script, ".str") ? strlen(script) - 4 : strlen(script);
+    const char* name = script;
+    if (output_dir) {
+        for (const char* p = script; *p; p++)
+            if (is_separator(*p)) name = p + 1;
+    }
+    int n = output_dir ? snprintf(buffer, size, "%s/%.*s.out", output_dir, (int)(stem - (size_t)(name - script)), name)
+                       : snprintf(buffer, size, "%.*s.out", (int)stem, script);
+    return n > 0 && (size_t)n < size;
+}
+
+static int compare_strings(const void* a, const void* b) {
+    return strcmp(*(char* const*)a, *(char* const*)b);
+}
+
+// 出力ファイルが重なるスクリプト（--output DIR で同じ名前、リストに同じパスが2度）を報告して 1 を返す。
+// 実行すれば後のものが黙って上書きし、別のワーカーなら同じファイルへ同時に書くので、実行前に止める
+static int find_output_clash(const JobList* list, const char* output_dir) {
+    char** outputs = malloc(sizeof(char*) * (size_t)list->count);
+    if (!outputs) { perror("malloc failed"); exit(EXIT_FAILURE); }
+    int count = 0, clash = 0;
+    char path[BATCH_PATH_MAX];
+    for (int i = 0; i < list->count; i++) {
+        if (!output_file_path(path, sizeof(path), list->jobs[i].path, output_dir)) continue; // 実行時に output failed になる
+        size_t length = strlen(path);
+        outputs[count] = malloc(length + 1);
+        if (!outputs[count]) { perror("malloc failed"); exit(EXIT_FAILURE); }
+        memcpy(outputs[count++], path, length + 1);
+    }
+    qsort(outputs, (size_t)count, sizeof(char*), compare_strings);
+    for (int i = 1; i < count; i++) {
+        if (strcmp(outputs[i - 1], outputs[i]) != 0 || (i > 1 && strcmp(outputs[i - 2], outputs[i]) == 0)) continue;
+        fprintf(stderr, "Error: more than one script would write %s\n", outputs[i]);
+        clash = 1;
+    }
+    for (int i = 0; i < count; i++) free(outputs[i]);
+    free(outputs);
+    return clash;
+}
+
+// main.c の run_file と同じ手順で、専用の Interpreter で実行する
+static BatchStatus run_script(const BatchJob* job, const BatchOptions* options) {
+    char path[BATCH_PATH_MAX];
+    if (!output_file_path(path, sizeof(path), job->path, options->output_dir)) return BATCH_OUTPUT_FAILED;
+    SourceBuffer source;
+    if (!source_open(&source, job->path)) return BATCH_READ_FAILED;
+    FILE* file = fopen(path, "wb");
+    if (!file) {
+        fprintf(stderr, "Error opening output file %s: %s\n", path, strerror(errno));
+        source_close(&source);
+        return BATCH_OUTPUT_FAILED;
+    }
+    ErrorCounter errors = { file, 0 };
+    Interpreter* interpreter = interpreter_create(allocator_default());
+    interpreter->output = output_file_sink(file);
+    interpreter->errors.write = count_error;
+    interpreter->errors.context = &errors;
+
+    BatchStatus status = BATCH_OK;
+    Arena arena;
+    arena_init(&arena, allocator_default(), ALLOC_AST);
+    CacheEntry cache;
+    int use_cache = options->cache_dir && !options->tree_walk &&
+                    cache_entry_init(&cache, options->cache_dir, source.data, source.length, interpreter->statement_markers);
+    Program* program = use_cache ? cache_load(&cache, interpreter) : NULL;
+    if (!program) {
+        Parser* parser = parser_create(source.data, (int)source.length, &arena, allocator_default());
+        parser->errors = interpreter->errors;
+        ASTNode* ast = parse(parser);
+        parser_free(parser);
+        if (!ast) status = BATCH_PARSE_FAILED;
+        else if ((ast = optimize(ast, &arena)) != NULL) {
+            resolve_names(interpreter, ast);
+            infer_types(interpreter, ast, NULL);
+            if (options->tree_walk) interpret(interpreter, ast);
+            else if ((program = compile(ast, interpreter)) != NULL && use_cache) cache_store(&cache, program, interpreter);
+        }
+    }
+    if (program) {
+        VM* vm = vm_create(interpreter);
+        vm_run(vm, program);
+        vm_free(vm);
+    }
+    if (status == BATCH_OK && errors.count > 0) status = BATCH_ERROR;
+
+    // カテゴリ本体がプログラムと AST を参照しているので、インタプリタの後に解放する
+    interpreter_free(interpreter);
+    program_free(program);
+    arena_free(&arena);
+    if (fclose(file) != 0 && status == BATCH_OK) status = BATCH_OUTPUT_FAILED;
+    source_close(&source);
+    return status;
+}
+
+static void run_job(BatchJob* job, const BatchOptions* options) {
+    StatsTime start = stats_now();
+    job->status = run_script(job, options);
+    job->seconds = stats_now().wall - start.wall;
+}
+
+// --- Work Stealing ---
+// ワーカーごとの両端キュー。大きいスクリプトから順に配り、持ち主は先頭（大きい方）から取る。
+// 自分のキューが空になったワーカーは、他のキューの末尾（小さい方）から盗む。
+// 実行中にジョブは増えないので、すべてのキューが空ならそのワーカーは終わる
+typedef struct {
+    int* items;     // ジョブ番号
+    int head;
+    int tail;
+#ifndef _WIN32
+    pthread_mutex_t lock;
+#endif
+} JobQueue;
+
+typedef struct {
+    BatchJob* jobs;
+    JobQueue* queues;
+    int worker_count;
+    const BatchOptions* options;
+    int steals;
+} Batch;
+
+typedef struct {
+    Batch* batch;
+    int index;
+} BatchWorker;
+
+// キューが空なら -1
+static int queue_take(JobQueue* queue, int steal) {
+#ifndef _WIN32
+    pthread_mutex_lock(&queue->lock);
+#endif
+    int job = -1;
+    if (queue->head < queue->tail) job = steal ? queue->items[--queue->tail] : queue->items[queue->head++];
+#ifndef _WIN32
+    pthread_mutex_unlock(&queue->lock);
+#endif
+    return job;
+}
+
+static void* worker_main(void* arg) {
+    BatchWorker* worker = arg;
+    Batch* batch = worker->batch;
+    while (1) {
+        int job = queue_take(&batch->queues[worker->index], 0);
+        for (int i = 1; job < 0 && i < batch->worker_count; i++) {
+            job = queue_take(&batch->queues[(worker->index + i) % batch->worker_count], 1);
+            if (job >= 0) __atomic_fetch_add(&batch->steals, 1, __ATOMIC_RELAXED);
+        }
+        if (job < 0) break;
+        run_job(&batch->jobs[job], batch->options);
+    }
+    return NULL;
+}
+
+// 大きい順、同じ大きさなら一覧の順
+static int compare_sizes(const void* a, const void* b) {
+    const BatchJob* x = *(const BatchJob* const*)a;
+    const BatchJob* y = *(const BatchJob* const*)b;
+    if (x->size != y->size) return x->size < y->size ? 1 : -1;
+    return x < y ? -1 : x > y;
+}
+
+// 呼び出したスレッドもワーカー 0 として実行する
+static void run_workers(Batch* batch, int count) {
+    BatchJob** order = malloc(sizeof(BatchJob*) * (size_t)count);
+    batch->queues = calloc((size_t)batch->worker_count, sizeof(JobQueue));
+    BatchWorker* workers = malloc(sizeof(BatchWorker) * (size_t)batch->worker_count);
+    if (!order || !batch->queues || !workers) { perror("malloc failed"); exit(EXIT_FAILURE); }
+    for (int i = 0; i < count; i++) order[i] = &batch->jobs[i];
+    qsort(order, (size_t)count, sizeof(*order), compare_sizes);
+    for (int w = 0; w < batch->worker_count; w++) {
+        JobQueue* queue = &batch->queues[w];
+        queue->items = malloc(sizeof(int) * (size_t)(count / batch->worker_count + 1));
+        if (!queue->items) { perror("malloc failed"); exit(EXIT_FAILURE); }
+        for (int i = w; i < count; i += batch->worker_count) queue->items[queue->tail++] = (int)(order[i] - batch->jobs);
+#ifndef _WIN32
+        pthread_mutex_init(&queue->lock, NULL);
+#endif
+        workers[w].batch = batch;
+        workers[w].index = w;
+    }
+    free(order);
+
+#ifdef _WIN32
+    // スレッドなしで順に実行する
+    for (int w = 0; w < batch->worker_count; w++) worker_main(&workers[w]);
+#else
+    pthread_t* threads = malloc(sizeof(pthread_t) * (size_t)batch->worker_count);
+    if (!threads) { perror("malloc failed"); exit(EXIT_FAILURE); }
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setstacksize(&attr, WORKER_STACK_SIZE);
+    int started = 1;
+    for (; started < batch->worker_count; started++) {
+        if (pthread_create(&threads[started], &attr, worker_main, &workers[started]) != 0) {
+            perror("Error starting batch worker");
+            break;  // 残りのキューは他のワーカーが盗んで実行する
+        }
+    }
+    pthread_attr_destroy(&attr);
+    worker_main(&workers[0]);
+    for (int w = 1; w < started; w++) pthread_join(threads[w], NULL);
+    free(threads);
+#endif
+
+    for (int w = 0; w < batch->worker_count; w++) {
+#ifndef _WIN32
+        pthread_mutex_destroy(&batch->queues[w].lock);
+#endif
+        free(batch->queues[w].items);
+    }
+    free(batch->queues);
+    free(workers);
+}
+
+// --- Batch ---
+int batch_run(const char* path, const BatchOptions* options, FILE* summary) {
+    JobList list = { NULL, 0, 0 };
+    DIR* dir = opendir(path);
+    if (dir) list_directory(&list, dir, path);
+    else if (!list_file(&list, path)) return -1;
+    if (list.count == 0) {
+        fprintf(stderr, "Error: no scripts to run in %s\n", path);
+        return -1;
+    }
+    if (find_output_clash(&list, options->output_dir)) {
+        job_list_free(&list);
+        return -1;
+    }
+    if (options->output_dir && make_directory(options->output_dir) != 0 && errno != EEXIST) {
+        fprintf(stderr, "Error creating output directory %s: %s\n", options->output_dir, strerror(errno));
+        job_list_free(&list);
+        return -1;
+    }
+
+    Batch batch;
+    batch.jobs = list.jobs;
+    batch.worker_count = options->jobs > 0 ? options->jobs : parallel_default_threads();
+    if (batch.worker_count > list.count) batch.worker_count = list.count;
+    batch.options = options;
+    batch.steals = 0;
+    StatsTime start = stats_now();
+    run_workers(&batch, list.count);
+    double total = stats_now().wall - start.wall;
+
+    int failed = 0;
+    double busy = 0;
+    fprintf(summary, "  %-13s %12s  %s\n", "status", "ms", "script");
+    for (int i = 0; i < list.count; i++) {
+        BatchJob* job = &list.jobs[i];
+        if (job->status != BATCH_OK) failed++;
+        busy += job->seconds;
+        fprintf(summary, "  %-13s %12.3f  %s\n", status_names[job->status], job->seconds * 1e3, job->path);
+        free(job->path);
+    }
+    free(list.jobs);
+    fprintf(summary, "Batch: %d scripts, %d failed, %d workers, %d stolen, %.3f ms wall, %.3f ms in scripts\n",
+            list.count, failed, batch.worker_count, batch.steals, total * 1e3, busy * 1e3);
+    return failed;
+}
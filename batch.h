@@ -0,0 +1,19 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <stdio.h>
+
+// --batch: 多数のスクリプトを1つのプロセスでワークスティーリングのスレッドプールに振り分けて実行する。
+// スクリプトごとに専用の Interpreter を作り、標準出力とエラーを書いた順に1つのファイル（<名前>.out）へ書く
+typedef struct {
+    int jobs;               // ワーカースレッド数（0 = parallel_default_threads()）
+    int tree_walk;
+    const char* output_dir; // 出力ファイルの置き場所（NULL ならスクリプトの隣）
+    const char* cache_dir;  // NULL ならキャッシュを使わない
+} BatchOptions;
+
+// path がディレクトリならその直下の *.str を、そうでなければ1行に1つのパスを並べたリストを実行し、
+// スクリプトごとの時間と失敗を summary へ書く。失敗したスクリプトの数を返す（一覧を作れなければ -1）
+int batch_run(const char* path, const BatchOptions* options, FILE* summary);
+
+#endif
@@ -0,0 +1,291 @@
+// ベンチマークハーネス。ワークロードのスクリプトを生成し、
+// 字句解析・構文解析・実行（VM / ツリーウォーカー）の時間を別々に測る
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <time.h>
+#include "../lexer.h"
+#include "../parser.h"
+#include "../interpreter.h"
+#include "../resolver.h"
+#include "../optimizer.h"
+#include "../inference.h"
+#include "../compiler.h"
+#include "../vm.h"
+#include "../output.h"
+
+// --- Script Buffer ---
+typedef struct {
+    char* data;
+    int length;
+    int capacity;
+} Script;
+
+static void script_printf(Script* script, const char* format, ...) {
+    va_list args;
+    while (1) {
+        va_start(args, format);
+        int n = vsnprintf(script->data + script->length, (size_t)(script->capacity - script->length), format, args);
+        va_end(args);
+        if (script->length + n < script->capacity) { script->length += n; return; }
+        script->capacity = script->capacity * 2 + n;
+        script->data = realloc(script->data, (size_t)script->capacity);
+        if (!script->data) { perror("realloc failed"); exit(EXIT_FAILURE); }
+    }
+}
+
+// --- Workload Generators ---
+// size はワークロードごとの規模（文・カテゴリ・run の数など）
+
+// 少数の変数への大量の代入
+static void generate_flat_assign(Script* s, int size) {
+    for (int i = 0; i < 16; i++) script_printf(s, "v%d = '%d' /\n", i, i);
+    for (int i = 0; i < size; i++)
+        script_printf(s, "v%d = v%d + '%d' @ '2' /\n", i % 16, (i + 1) % 16, i % 100);
+}
+
+// 変数を挟んだ左結合の連結（畳み込まれないように変数を混ぜる）。1文あたり最大 1000 項
+static void generate_concat_chain(Script* s, int size) {
+    script_printf(s, "p = \"piece\" /\n");
+    for (int done = 0; done < size; ) {
+        int pieces = size - done < 1000 ? size - done : 1000;
+        script_printf(s, "write \"\"");
+        for (int i = 0; i < pieces; i++) script_printf(s, i % 2 ? " + \"-%d\"" : " + p", i);
+        script_printf(s, " /\n");
+        done += pieces;
+    }
+}
+
+// 多数のカテゴリを定義してそれぞれ一度ずつ実行する
+static void generate_categories(Script* s, int size) {
+    script_printf(s, "x = '0' /\n");
+    for (int i = 0; i < size; i++) script_printf(s, "func c%d()\n    re x = x + '%d' /\nend\n", i, i % 10);
+    for (int i = 0; i < size; i++) script_printf(s, "run c%d /\n", i);
+    script_printf(s, "num write x /\n");
+}
+
+// run の再帰。スタックを使い切らないよう深さ 1000 の再帰を繰り返す
+static void generate_recursion(Script* s, int size) {
+    int depth = size < 1000 ? size : 1000;
+    script_printf(s, "d = '0' /\nacc = '0' /\n");
+    script_printf(s, "func down()\n    re d = d + '1' /\n    re acc = acc + d %% '7' /\n    d < '%d' / ? run down /\nend\n", depth);
+    for (int done = 0; done < size; done += depth) script_printf(s, "re d = '0' /\nrun down /\n");
+    script_printf(s, "num write acc /\n");
+}
+
+// 多数の異なる変数を定義して読み返す
+static void generate_many_variables(Script* s, int size) {
+    for (int i = 0; i < size; i++) script_printf(s, "var_%d = '%d' /\n", i, i);
+    script_printf(s, "sum = '0' /\n");
+    for (int i = 0; i < size; i++) script_printf(s, "re sum = sum + var_%d /\n", i);
+    script_printf(s, "num write sum /\n");
+}
+
+// 長いコメントと長い文字列リテラル
+static void generate_comments_strings(Script* s, int size) {
+    char text[201];
+    for (int i = 0; i < 200; i++) text[i] = (char)('a' + i % 26);
+    text[200] = '\0';
+    for (int i = 0; i < size; i++) {
+        script_printf(s, "# %s\n", text);
+        script_printf(s, "s%d = \"%s\" /\n", i % 8, text);
+    }
+}
+
+typedef struct {
+    const char* name;
+    void (*generate)(Script* script, int size);
+} Workload;
+
+static const Workload workloads[] = {
+    { "flat_assign", generate_flat_assign },
+    { "concat_chain", generate_concat_chain },
+    { "categories", generate_categories },
+    { "recursion", generate_recursion },
+    { "many_variables", generate_many_variables },
+    { "comments_strings", generate_comments_strings },
+};
+#define WORKLOAD_COUNT ((int)(sizeof(workloads) / sizeof(workloads[0])))
+
+static Script generate(const Workload* workload, int size) {
+    Script script = { malloc(4096), 0, 4096 };
+    if (!script.data) { perror("malloc failed"); exit(EXIT_FAILURE); }
+    workload->generate(&script, size);
+    return script;
+}
+
+// --- Timing ---
+static double now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+static double time_tokenize(const Script* script) {
+    Arena arena;
+    arena_init(&arena, allocator_default(), ALLOC_TOKENS);
+    double start = now_ms();
+    tokenize(script->data, script->length, &arena);
+    double elapsed = now_ms() - start;
+    arena_free(&arena);
+    return elapsed;
+}
+
+static double time_parse(const Script* script) {
+    Arena arena;
+    arena_init(&arena, allocator_default(), ALLOC_AST);
+    double start = now_ms();
+    Parser* parser = parser_create(script->data, script->length, &arena, allocator_default());
+    parse(parser);
+    parser_free(parser);
+    double elapsed = now_ms() - start;
+    arena_free(&arena);
+    return elapsed;
+}
+
+// main.c の execute_source と同じ手順で実行する（構文解析は含めない）
+static double time_execute(const Script* script, int tree_walk) {
+    Arena arena;
+    arena_init(&arena, allocator_default(), ALLOC_AST);
+    Parser* parser = parser_create(script->data, script->length, &arena, allocator_default());
+    ASTNode* ast = parse(parser);
+    parser_free(parser);
+    if (!ast) {
+        fprintf(stderr, "bench: generated script failed to parse\n");
+        exit(EXIT_FAILURE);
+    }
+    Interpreter* interpreter = interpreter_create(allocator_default());
+    Program* program = NULL;
+    double start = now_ms();
+    ast = optimize(ast, &arena);
+    resolve_names(interpreter, ast);
+    infer_types(interpreter, ast, NULL);
+    if (tree_walk) {
+        interpret(interpreter, ast);
+    } else {
+        program = compile(ast, interpreter);
+        VM* vm = vm_create(interpreter);
+        vm_run(vm, program);
+        vm_free(vm);
+    }
+    output_flush();
+    double elapsed = now_ms() - start;
+    program_free(program);
+    interpreter_free(interpreter);
+    arena_free(&arena);
+    return elapsed;
+}
+
+// 最小値を採る
+static double best_of(int repeat, double (*measure)(const Script*), const Script* script) {
+    double best = measure(script);
+    for (int i = 1; i < repeat; i++) {
+        double t = measure(script);
+        if (t < best) best = t;
+    }
+    return best;
+}
+
+static double run_vm(const Script* script) { return time_execute(script, 0); }
+static double run_tree_walk(const Script* script) { return time_execute(script, 1); }
+
+// --- Main ---
+typedef struct {
+    const char* workload;
+    int size;
+    int bytes;
+    double tokenize_ms, parse_ms, vm_ms, tree_walk_ms;
+} BenchResult;
+
+static void usage(void) {
+    fprintf(stderr,
+            "Usage: strings_bench [options]\n"
+            "  --sizes N,N,...        Workload sizes (default 1000,10000,100000)\n"
+            "  --repeat N             Runs per measurement; the fastest is reported (default 3)\n"
+            "  --workload NAME        Run only this workload\n"
+            "  --json FILE            Also write the results as JSON to FILE\n"
+            "  --emit NAME SIZE       Print the generated script instead of benchmarking\n");
+}
+
+static const Workload* find_workload(const char* name) {
+    for (int i = 0; i < WORKLOAD_COUNT; i++)
+        if (strcmp(workloads[i].name, name) == 0) return &workloads[i];
+    fprintf(stderr, "bench: unknown workload '%s'\n", name);
+    return NULL;
+}
+
+int main(int argc, char* argv[]) {
+    int sizes[16] = { 1000, 10000, 100000 };
+    int size_count = 3, repeat = 3;
+    const char* json_path = NULL;
+    const Workload* only = NULL;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--sizes") == 0 && i + 1 < argc) {
+            size_count = 0;
+            for (char* p = argv[++i]; *p && size_count < 16; ) {
+                sizes[size_count++] = (int)strtol(p, &p, 10);
+                if (*p == ',') p++;
+            }
+        } else if (strcmp(argv[i], "--repeat") == 0 && i + 1 < argc) {
+            repeat = atoi(argv[++i]);
+            if (repeat < 1) repeat = 1;
+        } else if (strcmp(argv[i], "--workload") == 0 && i + 1 < argc) {
+            if (!(only = find_workload(argv[++i]))) return 1;
+        } else if (strcmp(argv[i], "--json") == 0 && i + 1 < argc) {
+            json_path = argv[++i];
+        } else if (strcmp(argv[i], "--emit") == 0 && i + 2 < argc) {
+            const Workload* workload = find_workload(argv[i + 1]);
+            if (!workload) return 1;
+            Script script = generate(workload, atoi(argv[i + 2]));
+            fwrite(script.data, 1, (size_t)script.length, stdout);
+            free(script.data);
+            return 0;
+        } else {
+            usage();
+            return 1;
+        }
+    }
+
+    // スクリプトの出力は測定の邪魔なので捨てる
+    if (!output_open("/dev/null")) return 1;
+    BenchResult* results = malloc(sizeof(BenchResult) * WORKLOAD_COUNT * size_count);
+    int result_count = 0;
+    printf("workload,size,bytes,tokenize_ms,parse_ms,vm_ms,tree_walk_ms\n");
+    for (int w = 0; w < WORKLOAD_COUNT; w++) {
+        if (only && only != &workloads[w]) continue;
+        for (int i = 0; i < size_count; i++) {
+            Script script = generate(&workloads[w], sizes[i]);
+            BenchResult* result = &results[result_count++];
+            result->workload = workloads[w].name;
+            result->size = sizes[i];
+            result->bytes = script.length;
+            result->tokenize_ms = best_of(repeat, time_tokenize, &script);
+            result->parse_ms = best_of(repeat, time_parse, &script);
+            result->vm_ms = best_of(repeat, run_vm, &script);
+            result->tree_walk_ms = best_of(repeat, run_tree_walk, &script);
+            printf("%s,%d,%d,%.3f,%.3f,%.3f,%.3f\n", result->workload, result->size, result->bytes,
+                   result->tokenize_ms, result->parse_ms, result->vm_ms, result->tree_walk_ms);
+            fflush(stdout);
+            free(script.data);
+        }
+    }
+    output_close();
+
+    if (json_path) {
+        FILE* json = fopen(json_path, "w");
+        if (!json) { perror("Error opening JSON file"); free(results); return 1; }
+        fprintf(json, "[\n");
+        for (int i = 0; i < result_count; i++) {
+            BenchResult* r = &results[i];
+            fprintf(json, "  {\"workload\": \"%s\", \"size\": %d, \"bytes\": %d, \"tokenize_ms\": %.3f, "
+                          "\"parse_ms\": %.3f, \"vm_ms\": %.3f, \"tree_walk_ms\": %.3f}%s\n",
+                    r->workload, r->size, r->bytes, r->tokenize_ms, r->parse_ms, r->vm_ms, r->tree_walk_ms,
+                    i + 1 < result_count ? "," : "");
+        }
+        fprintf(json, "]\n");
+        fclose(json);
+    }
+    free(results);
+    return 0;
+}
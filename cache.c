@@ -0,0 +1,373 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/stat.h>
+#include "cache.h"
+#include "source.h"
+
+#ifdef _WIN32
+#include <direct.h>
+#include <process.h>
+#define make_directory(path) _mkdir(path)
+#define process_id() _getpid()
+#else
+#include <unistd.h>
+#define make_directory(path) mkdir(path, 0777)
+#define process_id() getpid()
+#endif
+
+#define CACHE_MAGIC "STRC"
+#define CACHE_ENDIAN 0x01020304u
+#define NO_SLOT_TYPES 0xffffffffu
+#define NO_NAME 0xffffffffu
+
+// ファイル先頭。payload はこの直後に続く
+typedef struct {
+    char magic[4];
+    uint32_t endian;        // 書いたマシンと同じバイト順でなければ読まない
+    uint32_t format;
+    uint32_t reserved;
+    uint64_t key;
+    uint64_t source_length;
+    uint64_t payload_length;
+    uint64_t checksum;      // payload の FNV-1a
+} CacheHeader;
+
+// FNV-1a (64bit)
+static uint64_t hash_bytes(uint64_t hash, const void* data, size_t length) {
+    const unsigned char* p = data;
+    for (size_t i = 0; i < length; i++) {
+        hash ^= p[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+#define HASH_SEED 14695981039346656037ull
+
+int cache_entry_init(CacheEntry* entry, const char* dir, const char* source, size_t length, int statement_markers) {
+    // 版・命令の表現・コンパイル条件が変わればファイル名も変わる
+    uint32_t build[4] = { CACHE_FORMAT_VERSION, OP_COUNT, (uint32_t)sizeof(Instruction), (uint32_t)statement_markers };
+    uint64_t key = hash_bytes(HASH_SEED, STRINGS_VERSION, strlen(STRINGS_VERSION));
+    key = hash_bytes(key, build, sizeof(build));
+    key = hash_bytes(key, source, length);
+    entry->key = key;
+    entry->source_length = length;
+    if (make_directory(dir) != 0 && errno != EEXIST) {
+        fprintf(stderr, "Warning: cannot create cache directory %s: %s\n", dir, strerror(errno));
+        return 0;
+    }
+    int n = snprintf(entry->path, sizeof(entry->path), "%s/%016llx.strc", dir, (unsigned long long)key);
+    return n > 0 && (size_t)n < sizeof(entry->path);
+}
+
+// --- Writer ---
+typedef struct {
+    unsigned char* data;
+    size_t length;
+    size_t capacity;
+} Buffer;
+
+static void put_bytes(Buffer* buffer, const void* data, size_t length) {
+    if (buffer->length + length > buffer->capacity) {
+        size_t capacity = buffer->capacity ? buffer->capacity * 2 : 4096;
+        while (capacity < buffer->length + length) capacity *= 2;
+        unsigned char* grown = realloc(buffer->data, capacity);
+        if (!grown) { perror("realloc failed"); exit(EXIT_FAILURE); }
+        buffer->data = grown;
+        buffer->capacity = capacity;
+    }
+    memcpy(buffer->data + buffer->length, data, length);
+    buffer->length += length;
+}
+
+static void put_u32(Buffer* buffer, uint32_t value) { put_bytes(buffer, &value, sizeof(value)); }
+
+// 長さ + 本体 + NUL（読み込み側は NUL 終端のまま使う）
+static void put_string(Buffer* buffer, const char* chars, size_t length) {
+    put_u32(buffer, (uint32_t)length);
+    put_bytes(buffer, chars, length);
+    put_bytes(buffer, "", 1);
+}
+
+static void put_names(Buffer* buffer, const SymbolTable* table) {
+    put_u32(buffer, (uint32_t)table->count);
+    for (int i = 0; i < table->count; i++) put_string(buffer, table->names[i], strlen(table->names[i]));
+}
+
+void cache_store(const CacheEntry* entry, const Program* program, const Interpreter* interpreter) {
+    Buffer payload = { NULL, 0, 0 };
+    put_names(&payload, &interpreter->symbols);
+    put_names(&payload, &interpreter->category_names);
+    if (interpreter->slot_types) {
+        put_u32(&payload, (uint32_t)interpreter->slot_type_count);
+        put_bytes(&payload, interpreter->slot_types, (size_t)interpreter->slot_type_count);
+    } else {
+        put_u32(&payload, NO_SLOT_TYPES);
+    }
+    put_u32(&payload, (uint32_t)program->constant_count);
+    for (int i = 0; i < program->constant_count; i++) {
+        const EvalResult* constant = &program->constants[i];
+        if (constant->type == RESULT_NUMBER) {
+            put_u32(&payload, 0);
+            put_bytes(&payload, &constant->value.number, sizeof(double));
+        } else {
+            put_u32(&payload, 1);
+            put_string(&payload, result_chars(constant), (size_t)result_length(constant));
+        }
+    }
+    put_u32(&payload, (uint32_t)program->function_count);
+    for (int i = 0; i < program->function_count; i++) {
+        const Function* function = program->functions[i];
+        if (function->name) put_string(&payload, function->name, strlen(function->name));
+        else put_u32(&payload, NO_NAME);
+        put_u32(&payload, (uint32_t)function->register_count);
+        put_u32(&payload, (uint32_t)function->count);
+        put_bytes(&payload, function->code, sizeof(Instruction) * (size_t)function->count);
+    }
+
+    CacheHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, CACHE_MAGIC, 4);
+    header.endian = CACHE_ENDIAN;
+    header.format = CACHE_FORMAT_VERSION;
+    header.key = entry->key;
+    header.source_length = entry->source_length;
+    header.payload_length = payload.length;
+    header.checksum = hash_bytes(HASH_SEED, payload.data, payload.length);
+
+    // 書きかけのファイルを読まれないよう、一時ファイルに書いてから置き換える。
+    // --batch では同じ内容のスクリプトを複数のスレッドが同時に保存しうるので、一時ファイル名は呼び出しごとに変える
+    static unsigned temp_counter = 0;
+    unsigned temp_id = __atomic_fetch_add(&temp_counter, 1, __ATOMIC_RELAXED);
+    char temp_path[sizeof(entry->path) + 48];
+    snprintf(temp_path, sizeof(temp_path), "%s.%d.%u.tmp", entry->path, (int)process_id(), temp_id);
+    FILE* file = fopen(temp_path, "wb");
+    int ok = file != NULL;
+    if (ok) {
+        ok = fwrite(&header, sizeof(header), 1, file) == 1 &&
+             (payload.length == 0 || fwrite(payload.data, payload.length, 1, file) == 1);
+        ok = fclose(file) == 0 && ok;
+    }
+#ifdef _WIN32
+    if (ok) remove(entry->path);
+#endif
+    if (ok) ok = rename(temp_path, entry->path) == 0;
+    if (!ok) {
+        fprintf(stderr, "Warning: cannot write cache file %s\n", entry->path);
+        remove(temp_path);
+    }
+    free(payload.data);
+}
+
+// --- Reader ---
+// 範囲外を読もうとしたら ok を 0 にして以後は 0 / NULL を返す
+typedef struct {
+    const unsigned char* p;
+    const unsigned char* end;
+    int ok;
+} Reader;
+
+static const void* get_bytes(Reader* reader, size_t length) {
+    if (!reader->ok || (size_t)(reader->end - reader->p) < length) { reader->ok = 0; return NULL; }
+    const void* data = reader->p;
+    reader->p += length;
+    return data;
+}
+
+static uint32_t get_u32(Reader* reader) {
+    uint32_t value = 0;
+    const void* data = get_bytes(reader, sizeof(value));
+    if (data) memcpy(&value, data, sizeof(value));
+    return value;
+}
+
+// NUL 終端を確かめた上でファイル上の文字列をそのまま返す
+static const char* get_string(Reader* reader, uint32_t length) {
+    const char* chars = get_bytes(reader, (size_t)length + 1);
+    if (chars && (chars[length] != '\0' || memchr(chars, '\0', length))) { reader->ok = 0; return NULL; }
+    return chars;
+}
+
+// 名前の一覧はファイル上の位置だけ覚えておき、すべて検証してから登録する
+static const unsigned char* skip_names(Reader* reader, uint32_t* count) {
+    const unsigned char* start = reader->p;
+    *count = get_u32(reader);
+    for (uint32_t i = 0; i < *count && reader->ok; i++) get_string(reader, get_u32(reader));
+    return start;
+}
+
+static int intern_names(Reader* reader, Interpreter* interpreter, int categories) {
+    uint32_t count = get_u32(reader);
+    for (uint32_t i = 0; i < count; i++) {
+        const char* name = get_string(reader, get_u32(reader));
+        int slot = categories ? interpreter_intern_category(interpreter, name) : interpreter_intern(interpreter, name);
+        if (slot != (int)i) return 0;
+    }
+    return 1;
+}
+
+static int register_ok(const Function* function, uint32_t reg) {
+    return reg < (uint32_t)function->register_count;
+}
+
+// 命令のオペランドが範囲内か（壊れたファイルで VM が範囲外を触らないように）
+static int instruction_valid(const Instruction* ip, const Function* function, const Program* program,
+                             uint32_t symbol_count, uint32_t category_count) {
+    switch (ip->op) {
+        case OP_LOAD_CONST:
+            return register_ok(function, ip->a) && ip->b < (uint32_t)program->constant_count;
+        case OP_GET_VAR: case OP_SET_VAR: case OP_RE_SET_VAR:
+        case OP_GET_NUM: case OP_SET_NUM: case OP_RE_SET_NUM:
+            return register_ok(function, ip->a) && ip->b < symbol_count;
+        case OP_SUNUM: case OP_NUM_WRITE:
+            return ip->b < symbol_count;
+        case OP_ADD: case OP_SUB: case OP_MUL: case OP_DIV: case OP_MOD:
+        case OP_GT: case OP_LT: case OP_GTE: case OP_LTE: case OP_EQ: case OP_NEQ:
+        case OP_AND: case OP_OR:
+            return register_ok(function, ip->a) && register_ok(function, ip->b) && register_ok(function, ip->c);
+        case OP_POS: case OP_NEG: case OP_NOT:
+            return register_ok(function, ip->a) && register_ok(function, ip->b);
+        case OP_WRITE: case OP_DISCARD:
+            return register_ok(function, ip->a);
+        case OP_JUMP:
+            return ip->b < (uint32_t)function->count;
+        case OP_JUMP_IF_FALSE:
+            return register_ok(function, ip->a) && ip->b < (uint32_t)function->count;
+        case OP_DEFINE_CATEGORY:
+            return ip->b < category_count && ip->c > 0 && ip->c < (uint32_t)program->function_count;
+        case OP_RUN:
+            return ip->b < category_count;
+        case OP_CALL: case OP_CALL_VALUE:
+            return (ip->op == OP_CALL || register_ok(function, ip->a)) &&
+                   ip->b < (uint32_t)program->constant_count && program->constants[ip->b].type != RESULT_NUMBER &&
+                   ip->c < (uint32_t)program->constant_count && program->constants[ip->c].type != RESULT_NUMBER;
+        case OP_PRUN:
+            if (ip->b > (uint32_t)program->constant_count || ip->c > (uint32_t)program->constant_count - ip->b) return 0;
+            for (uint32_t i = ip->b; i < ip->b + ip->c; i++) {
+                const EvalResult* slot = &program->constants[i];
+                if (slot->type != RESULT_NUMBER || !(slot->value.number >= 0 && slot->value.number < category_count)
+                    || slot->value.number != (double)(uint32_t)slot->value.number) return 0;
+            }
+            return 1;
+        case OP_STMT: case OP_RETURN:
+            return 1;
+        default:
+            return 0;   // 型特化命令は実行時にしか現れない
+    }
+}
+
+static Program* read_program(Reader* reader, Interpreter* interpreter, uint32_t symbol_count, uint32_t category_count) {
+    Allocator* allocator = interpreter->allocator;
+    Program* program = program_create(allocator);
+    uint32_t constant_count = get_u32(reader);
+    for (uint32_t i = 0; i < constant_count && reader->ok; i++) {
+        EvalResult constant;
+        if (get_u32(reader) == 0) {
+            const void* number = get_bytes(reader, sizeof(double));
+            if (!number) break;
+            double value;
+            memcpy(&value, number, sizeof(value));
+            constant = create_number_result(value);
+        } else {
+            uint32_t length = get_u32(reader);
+            const char* chars = get_string(reader, length);
+            if (!chars) break;
+            constant = create_chars_result(allocator, chars, (int)length);
+        }
+        if (program->constant_count >= program->constant_capacity) {
+            program->constants = allocator_realloc(allocator, program->constants,
+                                                   sizeof(EvalResult) * program->constant_capacity,
+                                                   sizeof(EvalResult) * program->constant_capacity * 2, ALLOC_CODE);
+            program->constant_capacity *= 2;
+        }
+        program->constants[program->constant_count++] = constant;
+    }
+    uint32_t function_count = get_u32(reader);
+    for (uint32_t i = 0; i < function_count && reader->ok; i++) {
+        uint32_t name_length = get_u32(reader);
+        const char* name = name_length == NO_NAME ? NULL : get_string(reader, name_length);
+        if ((i == 0) != (name == NULL)) reader->ok = 0;     // 名前がないのはトップレベルだけ
+        uint32_t register_count = get_u32(reader);
+        uint32_t count = get_u32(reader);
+        const void* code = get_bytes(reader, sizeof(Instruction) * (size_t)count);
+        if (!code || count == 0 || register_count > 65535) { reader->ok = 0; break; }
+        Function* function = function_create(program, name);
+        function->register_count = (int)register_count;
+        if ((int)count > function->capacity) {
+            function->code = allocator_realloc(allocator, function->code, sizeof(Instruction) * function->capacity,
+                                               sizeof(Instruction) * count, ALLOC_CODE);
+            function->capacity = (int)count;
+        }
+        memcpy(function->code, code, sizeof(Instruction) * count);
+        function->count = (int)count;
+    }
+    if (!reader->ok || reader->p != reader->end || program->function_count == 0) {
+        program_free(program);
+        return NULL;
+    }
+    for (int i = 0; i < program->function_count; i++) {
+        const Function* function = program->functions[i];
+        if (function->code[function->count - 1].op != OP_RETURN) { program_free(program); return NULL; }
+        for (int j = 0; j < function->count; j++) {
+            if (!instruction_valid(&function->code[j], function, program, symbol_count, category_count)) {
+                program_free(program);
+                return NULL;
+            }
+        }
+    }
+    return program;
+}
+
+Program* cache_load(const CacheEntry* entry, Interpreter* interpreter) {
+    struct stat st;
+    if (stat(entry->path, &st) != 0) return NULL;
+    SourceBuffer file;
+    if (!source_open(&file, entry->path)) return NULL;
+
+    Program* program = NULL;
+    CacheHeader header;
+    if (file.length < sizeof(header)) goto done;
+    memcpy(&header, file.data, sizeof(header));
+    if (memcmp(header.magic, CACHE_MAGIC, 4) != 0 || header.endian != CACHE_ENDIAN ||
+        header.format != CACHE_FORMAT_VERSION || header.key != entry->key ||
+        header.source_length != entry->source_length || header.payload_length != file.length - sizeof(header))
+        goto done;
+    const unsigned char* payload = (const unsigned char*)file.data + sizeof(header);
+    if (hash_bytes(HASH_SEED, payload, header.payload_length) != header.checksum) goto done;
+
+    Reader reader = { payload, payload + header.payload_length, 1 };
+    uint32_t symbol_count, category_count;
+    const unsigned char* symbols = skip_names(&reader, &symbol_count);
+    const unsigned char* categories = skip_names(&reader, &category_count);
+    uint32_t slot_type_count = get_u32(&reader);
+    const unsigned char* slot_types = NULL;
+    if (slot_type_count != NO_SLOT_TYPES) {
+        slot_types = get_bytes(&reader, slot_type_count);
+        if (slot_type_count > symbol_count) reader.ok = 0;
+        for (uint32_t i = 0; slot_types && i < slot_type_count; i++)
+            if (slot_types[i] > TYPE_DYNAMIC) reader.ok = 0;
+    }
+    if (!reader.ok) goto done;
+    program = read_program(&reader, interpreter, symbol_count, category_count);
+    if (!program) goto done;
+
+    // ここまでで全体を検証済み。Interpreter に名前を登録してスロット番号を再現する
+    Reader names = { symbols, reader.end, 1 };
+    Reader category_names = { categories, reader.end, 1 };
+    if (!intern_names(&names, interpreter, 0) || !intern_names(&category_names, interpreter, 1)) {
+        program_free(program);
+        program = NULL;
+        goto done;
+    }
+    if (slot_types) {
+        // infer_types と同じく 1 バイト多く取る
+        interpreter->slot_types = allocator_calloc(interpreter->allocator, (size_t)slot_type_count + 1, 1, ALLOC_VARIABLES);
+        memcpy(interpreter->slot_types, slot_types, slot_type_count);
+        interpreter->slot_type_count = (int)slot_type_count;
+    }
+done:
+    source_close(&file);
+    return program;
+}
@@ -0,0 +1,30 @@
+#ifndef CACHE_H
+#define CACHE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "compiler.h"
+#include "interpreter.h"
+
+// コンパイル済みスクリプトのキャッシュ（.strc）。
+// ファイル名はソースの内容・インタプリタの版・コンパイル条件から求めたハッシュで、
+// 中身はバイトコードと、スロット番号を再現するための変数名・カテゴリ名・型推論の結果。
+// 壊れている・古いファイルは読み込まずに NULL を返すので、呼び出し側はコンパイルし直して上書きする
+
+// 形式を変えたら上げる
+#define CACHE_FORMAT_VERSION 1
+
+typedef struct {
+    char path[1024];
+    uint64_t key;
+    uint64_t source_length;
+} CacheEntry;
+
+// dir がなければ作る。パスが長すぎるなどで使えなければ 0 を返す
+int cache_entry_init(CacheEntry* entry, const char* dir, const char* source, size_t length, int statement_markers);
+
+// 新しく作った Interpreter に変数名とカテゴリ名を登録し、プログラムを返す
+Program* cache_load(const CacheEntry* entry, Interpreter* interpreter);
+void cache_store(const CacheEntry* entry, const Program* program, const Interpreter* interpreter);
+
+#endif
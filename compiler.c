@@ -0,0 +1,312 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "compiler.h"
+#include "profile.h"
+
+#define MAX_REGISTERS 65535
+
+typedef struct {
+    Program* program;
+    Function* function;
+    int next_register;
+    int had_error;
+    const Interpreter* interpreter;
+} Compiler;
+
+static void compile_statement(Compiler* compiler, ASTNode* node);
+
+// --- Program / Function ---
+Function* function_create(Program* program, const char* name) {
+    Allocator* allocator = program->allocator;
+    Function* function = allocator_alloc(allocator, sizeof(Function), ALLOC_CODE);
+    function->name = name ? allocator_strdup(allocator, name, ALLOC_CODE) : NULL;
+    function->capacity = 16;
+    function->count = 0;
+    function->code = allocator_alloc(allocator, sizeof(Instruction) * function->capacity, ALLOC_CODE);
+    function->register_count = 0;
+    function->program = program;
+    if (program->function_count >= program->function_capacity) {
+        program->function_capacity *= 2;
+        program->functions = allocator_realloc(allocator, program->functions, sizeof(Function*) * program->function_count,
+                                               sizeof(Function*) * program->function_capacity, ALLOC_CODE);
+    }
+    program->functions[program->function_count++] = function;
+    return function;
+}
+
+Program* program_create(Allocator* allocator) {
+    Program* program = allocator_alloc(allocator, sizeof(Program), ALLOC_CODE);
+    program->allocator = allocator;
+    program->function_capacity = 4;
+    program->function_count = 0;
+    program->functions = allocator_alloc(allocator, sizeof(Function*) * program->function_capacity, ALLOC_CODE);
+    program->constant_capacity = 16;
+    program->constant_count = 0;
+    program->constants = allocator_alloc(allocator, sizeof(EvalResult) * program->constant_capacity, ALLOC_CODE);
+    return program;
+}
+
+void program_free(Program* program) {
+    if (!program) return;
+    Allocator* allocator = program->allocator;
+    for (int i = 0; i < program->function_count; i++) {
+        Function* function = program->functions[i];
+        allocator_free_string(allocator, function->name, ALLOC_CODE);
+        allocator_free(allocator, function->code, sizeof(Instruction) * function->capacity, ALLOC_CODE);
+        allocator_free(allocator, function, sizeof(Function), ALLOC_CODE);
+    }
+    allocator_free(allocator, program->functions, sizeof(Function*) * program->function_capacity, ALLOC_CODE);
+    for (int i = 0; i < program->constant_count; i++)
+        release_result(program->constants[i]);
+    allocator_free(allocator, program->constants, sizeof(EvalResult) * program->constant_capacity, ALLOC_CODE);
+    allocator_free(allocator, program, sizeof(Program), ALLOC_CODE);
+}
+
+static uint32_t add_constant(Program* program, EvalResult value) {
+    if (program->constant_count >= program->constant_capacity) {
+        program->constant_capacity *= 2;
+        program->constants = allocator_realloc(program->allocator, program->constants, sizeof(EvalResult) * program->constant_count,
+                                               sizeof(EvalResult) * program->constant_capacity, ALLOC_CODE);
+    }
+    program->constants[program->constant_count] = value;
+    return (uint32_t)program->constant_count++;
+}
+
+// 長い文字列リテラルはASTと同じ RString を共有する
+static uint32_t add_string_constant(Program* program, RString* value) {
+    return add_constant(program, share_string_result(value));
+}
+
+static uint32_t add_cstring_constant(Program* program, const char* value) {
+    return add_constant(program, create_cstring_result(program->allocator, value));
+}
+
+// --- Emitter ---
+static int emit(Compiler* compiler, OpCode op, int a, uint32_t b, uint32_t c) {
+    Function* function = compiler->function;
+    if (function->count >= function->capacity) {
+        function->capacity *= 2;
+        function->code = allocator_realloc(compiler->program->allocator, function->code, sizeof(Instruction) * function->count,
+                                           sizeof(Instruction) * function->capacity, ALLOC_CODE);
+    }
+    Instruction* instruction = &function->code[function->count];
+    instruction->op = (uint8_t)op;
+    instruction->deopts = 0;
+    instruction->a = (uint16_t)a;
+    instruction->b = b;
+    instruction->c = c;
+    return function->count++;
+}
+
+static void patch_jump(Compiler* compiler, int at) {
+    compiler->function->code[at].b = (uint32_t)compiler->function->count;
+}
+
+static int alloc_register(Compiler* compiler) {
+    if (compiler->next_register >= MAX_REGISTERS) {
+        if (!compiler->had_error) output_error(&compiler->interpreter->errors, "Compile error: Expression too deeply nested\n");
+        compiler->had_error = 1;
+        return compiler->next_register - 1;
+    }
+    int reg = compiler->next_register++;
+    if (compiler->next_register > compiler->function->register_count)
+        compiler->function->register_count = compiler->next_register;
+    return reg;
+}
+
+static void free_register(Compiler* compiler) {
+    compiler->next_register--;
+}
+
+static OpCode binary_opcode(TokenType op) {
+    switch (op) {
+        case TOKEN_PLUS: return OP_ADD;
+        case TOKEN_MINUS: return OP_SUB;
+        case TOKEN_MULTIPLY: case TOKEN_AT: return OP_MUL;
+        case TOKEN_DIVIDE: case TOKEN_YEN: case TOKEN_BACKSLASH: return OP_DIV;
+        case TOKEN_MOD: return OP_MOD;
+        case TOKEN_GT: return OP_GT;
+        case TOKEN_LT: return OP_LT;
+        case TOKEN_GTE: return OP_GTE;
+        case TOKEN_LTE: return OP_LTE;
+        case TOKEN_EQ: return OP_EQ;
+        case TOKEN_NEQ: return OP_NEQ;
+        case TOKEN_AMPERSAND: return OP_AND;
+        case TOKEN_PIPE: return OP_OR;
+        default: return OP_COUNT;
+    }
+}
+
+TokenType opcode_to_operator(OpCode op) {
+    switch (op) {
+        case OP_ADD: case OP_POS: return TOKEN_PLUS;
+        case OP_SUB: case OP_NEG: return TOKEN_MINUS;
+        case OP_MUL: return TOKEN_MULTIPLY;
+        case OP_DIV: return TOKEN_DIVIDE;
+        case OP_MOD: return TOKEN_MOD;
+        case OP_GT: return TOKEN_GT;
+        case OP_LT: return TOKEN_LT;
+        case OP_GTE: return TOKEN_GTE;
+        case OP_LTE: return TOKEN_LTE;
+        case OP_EQ: return TOKEN_EQ;
+        case OP_NEQ: return TOKEN_NEQ;
+        case OP_AND: return TOKEN_AMPERSAND;
+        case OP_OR: return TOKEN_PIPE;
+        case OP_NOT: return TOKEN_TILDE;
+        default: return TOKEN_ERROR;
+    }
+}
+
+// --- Expressions ---
+// 式の値をレジスタ dest に置く
+static void compile_expression(Compiler* compiler, ASTNode* node, int dest) {
+    switch (node->type) {
+        case AST_NUMBER:
+            emit(compiler, OP_LOAD_CONST, dest, add_constant(compiler->program, create_number_result(node->data.number.value)), 0);
+            break;
+        case AST_STRING:
+            emit(compiler, OP_LOAD_CONST, dest, add_string_constant(compiler->program, node->data.string.value), 0);
+            break;
+        case AST_IDENTIFIER:
+            emit(compiler, interpreter_slot_is_number(compiler->interpreter, node->data.identifier.slot) ? OP_GET_NUM : OP_GET_VAR,
+                 dest, (uint32_t)node->data.identifier.slot, 0);
+            break;
+        case AST_BINARY_OP: {
+            OpCode op = binary_opcode(node->data.binary_op.operator);
+            compile_expression(compiler, node->data.binary_op.left, dest);
+            int right = alloc_register(compiler);
+            compile_expression(compiler, node->data.binary_op.right, right);
+            free_register(compiler);
+            if (op == OP_COUNT) {
+                output_error(&compiler->interpreter->errors, "Compile error: Unsupported binary operator %s\n", token_to_string(node->data.binary_op.operator));
+                compiler->had_error = 1;
+                break;
+            }
+            emit(compiler, op, dest, (uint32_t)dest, (uint32_t)right);
+            break;
+        }
+        case AST_UNARY_OP: {
+            OpCode op = node->data.unary_op.operator == TOKEN_PLUS ? OP_POS
+                      : node->data.unary_op.operator == TOKEN_MINUS ? OP_NEG : OP_NOT;
+            compile_expression(compiler, node->data.unary_op.operand, dest);
+            emit(compiler, op, dest, (uint32_t)dest, 0);
+            break;
+        }
+        case AST_CALL_EXPRESSION:
+            emit(compiler, OP_CALL_VALUE, dest, add_cstring_constant(compiler->program, node->data.call_statement.language),
+                 add_cstring_constant(compiler->program, node->data.call_statement.code));
+            break;
+        default:
+            output_error(&compiler->interpreter->errors, "Compile error: Cannot compile AST type %d as expression\n", node->type);
+            compiler->had_error = 1;
+            break;
+    }
+}
+
+// --- Statements ---
+static void compile_category(Compiler* compiler, ASTNode* node) {
+    Compiler body = { compiler->program, NULL, 0, 0, compiler->interpreter };
+    body.function = function_create(compiler->program, node->data.category_definition.name);
+    int index = compiler->program->function_count - 1;
+    for (int i = 0; i < node->data.category_definition.statement_count; i++)
+        compile_statement(&body, node->data.category_definition.statements[i]);
+    emit(&body, OP_RETURN, 0, 0, 0);
+    if (body.had_error) compiler->had_error = 1;
+    emit(compiler, OP_DEFINE_CATEGORY, 0, (uint32_t)node->data.category_definition.slot, (uint32_t)index);
+}
+
+static void compile_statement(Compiler* compiler, ASTNode* node) {
+    if (!node) return;
+    if (compiler->interpreter->statement_markers && node->type != AST_COMPOUND_STATEMENT) {
+        Profile* profile = compiler->interpreter->profile;
+        emit(compiler, OP_STMT, 0, profile ? (uint32_t)profile_statement_id(profile, node->offset) : 0, 0);
+    }
+    switch (node->type) {
+        case AST_COMPOUND_STATEMENT:
+            for (int i = 0; i < node->data.compound_statement.statement_count; i++)
+                compile_statement(compiler, node->data.compound_statement.statements[i]);
+            break;
+        case AST_ASSIGNMENT:
+        case AST_RE_ASSIGNMENT: {
+            int reg = alloc_register(compiler);
+            compile_expression(compiler, node->data.assignment.expression, reg);
+            OpCode op = node->type == AST_ASSIGNMENT ? OP_SET_VAR : OP_RE_SET_VAR;
+            if (interpreter_slot_is_number(compiler->interpreter, node->data.assignment.slot))
+                op = node->type == AST_ASSIGNMENT ? OP_SET_NUM : OP_RE_SET_NUM;
+            emit(compiler, op, reg, (uint32_t)node->data.assignment.slot, 0);
+            free_register(compiler);
+            break;
+        }
+        case AST_SUNUM_STATEMENT:
+            emit(compiler, OP_SUNUM, 0, (uint32_t)node->data.assignment.slot, 0);
+            break;
+        case AST_WRITE_STATEMENT: {
+            int reg = alloc_register(compiler);
+            compile_expression(compiler, node->data.write_statement.expression, reg);
+            emit(compiler, OP_WRITE, reg, 0, 0);
+            free_register(compiler);
+            break;
+        }
+        case AST_NUM_WRITE_STATEMENT:
+            emit(compiler, OP_NUM_WRITE, 0, (uint32_t)node->data.num_write_statement.slot, 0);
+            break;
+        case AST_IF_STATEMENT: {
+            int reg = alloc_register(compiler);
+            compile_expression(compiler, node->data.if_statement.condition, reg);
+            int jump_else = emit(compiler, OP_JUMP_IF_FALSE, reg, 0, 0);
+            free_register(compiler);
+            compile_statement(compiler, node->data.if_statement.then_stmt);
+            if (node->data.if_statement.else_stmt) {
+                int jump_end = emit(compiler, OP_JUMP, 0, 0, 0);
+                patch_jump(compiler, jump_else);
+                compile_statement(compiler, node->data.if_statement.else_stmt);
+                patch_jump(compiler, jump_end);
+            } else {
+                patch_jump(compiler, jump_else);
+            }
+            break;
+        }
+        case AST_CATEGORY_DEFINITION:
+            compile_category(compiler, node);
+            break;
+        case AST_RUN_STATEMENT:
+            emit(compiler, OP_RUN, 0, (uint32_t)node->data.run_statement.slot, 0);
+            break;
+        case AST_PARALLEL_RUN_STATEMENT: {
+            uint32_t first = (uint32_t)compiler->program->constant_count;
+            for (int i = 0; i < node->data.parallel_run_statement.count; i++)
+                add_constant(compiler->program, create_number_result(node->data.parallel_run_statement.slots[i]));
+            emit(compiler, OP_PRUN, 0, first, (uint32_t)node->data.parallel_run_statement.count);
+            break;
+        }
+        case AST_CALL_STATEMENT:
+            emit(compiler, OP_CALL, 0, add_cstring_constant(compiler->program, node->data.call_statement.language),
+                 add_cstring_constant(compiler->program, node->data.call_statement.code));
+            break;
+        default:
+            if (node->type >= AST_NUMBER && node->type <= AST_CALL_EXPRESSION) {
+                int reg = alloc_register(compiler);
+                compile_expression(compiler, node, reg);
+                emit(compiler, OP_DISCARD, reg, 0, 0);
+                free_register(compiler);
+            } else {
+                output_error(&compiler->interpreter->errors, "Compile error: Cannot compile AST type %d\n", node->type);
+                compiler->had_error = 1;
+            }
+            break;
+    }
+}
+
+Program* compile(ASTNode* ast, const Interpreter* interpreter) {
+    Program* program = program_create(interpreter->allocator);
+    Compiler compiler = { program, NULL, 0, 0, interpreter };
+    compiler.function = function_create(program, NULL);
+    compile_statement(&compiler, ast);
+    emit(&compiler, OP_RETURN, 0, 0, 0);
+    if (compiler.had_error) {
+        program_free(program);
+        return NULL;
+    }
+    return program;
+}
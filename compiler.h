@@ -0,0 +1,83 @@
+#ifndef COMPILER_H
+#define COMPILER_H
+
+#include <stdint.h>
+#include "parser.h"
+#include "interpreter.h"
+
+// バイトコード命令
+// R[x] = レジスタ, K[x] = 定数プール
+typedef enum {
+    OP_LOAD_CONST,      // R[a] = K[b]
+    OP_GET_VAR,         // R[a] = 変数スロット b
+    OP_SET_VAR,         // 変数スロット b = R[a]
+    OP_RE_SET_VAR,      // re 変数スロット b = R[a]
+    OP_GET_NUM,         // R[a] = 数値スロット b（型推論で数値と証明された変数）
+    OP_SET_NUM,         // 数値スロット b = R[a]
+    OP_RE_SET_NUM,      // re 数値スロット b = R[a]
+    OP_SUNUM,           // sunum 変数スロット b
+    OP_ADD, OP_SUB, OP_MUL, OP_DIV, OP_MOD,
+    OP_GT, OP_LT, OP_GTE, OP_LTE, OP_EQ, OP_NEQ,
+    OP_AND, OP_OR,      // R[a] = R[b] op R[c]
+    OP_POS, OP_NEG, OP_NOT, // R[a] = op R[b]
+    OP_WRITE,           // write R[a]
+    OP_NUM_WRITE,       // num write 変数スロット b
+    OP_DISCARD,         // R[a] を捨てる（式文）
+    OP_JUMP,            // pc = b
+    OP_JUMP_IF_FALSE,   // R[a] が偽なら pc = b
+    OP_DEFINE_CATEGORY, // カテゴリスロット b の本体を関数 c とする
+    OP_RUN,             // run カテゴリスロット b
+    OP_CALL,            // call 言語 K[b], コード K[c]
+    OP_CALL_VALUE,      // R[a] = call 言語 K[b], コード K[c] の出力
+    OP_PRUN,            // prun カテゴリスロット K[b]..K[b+c-1]（数値定数）
+    OP_RETURN,
+    OP_STMT,            // 文の開始。b = プロファイラの文番号（statement_markers 指定時のみ出力）
+    // 型特化命令。コンパイラは出力せず、VMが実行時に汎用の二項演算命令を書き換えて使う。
+    // 数値版は OP_ADD..OP_OR と同じ並び
+    OP_ADD_NUM, OP_SUB_NUM, OP_MUL_NUM, OP_DIV_NUM, OP_MOD_NUM,
+    OP_GT_NUM, OP_LT_NUM, OP_GTE_NUM, OP_LTE_NUM, OP_EQ_NUM, OP_NEQ_NUM,
+    OP_AND_NUM, OP_OR_NUM,
+    OP_ADD_STR, OP_EQ_STR, OP_NEQ_STR,
+    OP_COUNT
+} OpCode;
+
+// 12バイト固定長命令
+typedef struct {
+    uint8_t op;
+    uint8_t deopts;     // 型特化命令から汎用命令へ戻された回数
+    uint16_t a;
+    uint32_t b;
+    uint32_t c;
+} Instruction;
+
+struct Program;
+
+typedef struct Function {
+    char* name;             // NULL = トップレベル
+    Instruction* code;
+    int count;
+    int capacity;
+    int register_count;
+    struct Program* program;
+} Function;
+
+// コンパイル単位。functions[0] がトップレベル
+typedef struct Program {
+    Function** functions;
+    int function_count;
+    int function_capacity;
+    EvalResult* constants;
+    int constant_count;
+    int constant_capacity;
+    Allocator* allocator;   // Interpreter のもの（ALLOC_CODE）
+} Program;
+
+// 変数スロットは resolve_names() 済みであること。
+// interpreter が型推論済みなら、数値と証明された変数はタグなしの命令で読み書きする
+Program* compile(ASTNode* ast, const Interpreter* interpreter);
+Program* program_create(Allocator* allocator);
+Function* function_create(Program* program, const char* name);    // program->functions の末尾に加える
+void program_free(Program* program);
+TokenType opcode_to_operator(OpCode op);
+
+#endif
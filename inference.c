@@ -0,0 +1,132 @@
+#include <stdlib.h>
+#include "inference.h"
+
+// 型は TYPE_UNKNOWN < TYPE_NUMBER, TYPE_STRING < TYPE_DYNAMIC の束で、代入のたびに合流させる。
+// 流れを見ないので、すべての代入で同じ型になる変数だけが証明される
+typedef struct {
+    unsigned char* types;
+    unsigned char* shared;      // sunum された変数（共有表へ移るので動的のまま）
+    int count;
+    int changed;
+} Inference;
+
+static ValueType join_types(ValueType a, ValueType b) {
+    if (a == b || b == TYPE_UNKNOWN) return a;
+    if (a == TYPE_UNKNOWN) return b;
+    return TYPE_DYNAMIC;
+}
+
+static void assign_type(Inference* inference, int slot, ValueType type) {
+    ValueType joined = join_types(inference->types[slot], type);
+    if (joined != inference->types[slot]) {
+        inference->types[slot] = joined;
+        inference->changed = 1;
+    }
+}
+
+// 式の結果の型。apply_binary_op / apply_unary_op の規則に合わせる
+static ValueType expression_type(Inference* inference, ASTNode* node) {
+    if (!node) return TYPE_NUMBER;
+    switch (node->type) {
+        case AST_NUMBER: return TYPE_NUMBER;
+        case AST_STRING: return TYPE_STRING;
+        case AST_IDENTIFIER: {
+            // 一度も代入されない変数の参照はエラーを出して 0 になる
+            ValueType type = inference->types[node->data.identifier.slot];
+            return type == TYPE_UNKNOWN ? TYPE_NUMBER : type;
+        }
+        case AST_BINARY_OP: {
+            ValueType left = expression_type(inference, node->data.binary_op.left);
+            ValueType right = expression_type(inference, node->data.binary_op.right);
+            // + 以外の演算子は（エラー時も含めて）常に数値を返す
+            if (node->data.binary_op.operator != TOKEN_PLUS) return TYPE_NUMBER;
+            if (left == TYPE_STRING || right == TYPE_STRING) return TYPE_STRING;
+            if (left == TYPE_NUMBER && right == TYPE_NUMBER) return TYPE_NUMBER;
+            return TYPE_DYNAMIC;
+        }
+        case AST_UNARY_OP:
+            expression_type(inference, node->data.unary_op.operand);
+            return TYPE_NUMBER;
+        case AST_CALL_EXPRESSION: return TYPE_STRING;
+        default:
+            return TYPE_DYNAMIC;
+    }
+}
+
+static void infer_statement(Inference* inference, ASTNode* node) {
+    if (!node) return;
+    switch (node->type) {
+        case AST_ASSIGNMENT:
+        case AST_RE_ASSIGNMENT:
+            assign_type(inference, node->data.assignment.slot, expression_type(inference, node->data.assignment.expression));
+            break;
+        case AST_SUNUM_STATEMENT:
+            inference->shared[node->data.assignment.slot] = 1;
+            assign_type(inference, node->data.assignment.slot, TYPE_DYNAMIC);
+            break;
+        case AST_IF_STATEMENT:
+            infer_statement(inference, node->data.if_statement.then_stmt);
+            infer_statement(inference, node->data.if_statement.else_stmt);
+            break;
+        case AST_COMPOUND_STATEMENT:
+            for (int i = 0; i < node->data.compound_statement.statement_count; i++)
+                infer_statement(inference, node->data.compound_statement.statements[i]);
+            break;
+        case AST_CATEGORY_DEFINITION:
+            for (int i = 0; i < node->data.category_definition.statement_count; i++)
+                infer_statement(inference, node->data.category_definition.statements[i]);
+            break;
+        default:
+            break;
+    }
+}
+
+static const char* type_name(ValueType type) {
+    switch (type) {
+        case TYPE_NUMBER: return "number";
+        case TYPE_STRING: return "string";
+        case TYPE_DYNAMIC: return "dynamic";
+        default: return "unknown";
+    }
+}
+
+static void report_types(Interpreter* interpreter, Inference* inference, FILE* report) {
+    fprintf(report, "Type inference:\n");
+    for (int slot = 0; slot < inference->count; slot++) {
+        const char* note = "";
+        switch (inference->types[slot]) {
+            case TYPE_NUMBER: note = " (unboxed)"; break;
+            case TYPE_DYNAMIC: note = inference->shared[slot] ? " (shared by sunum)" : " (assigned numbers and strings)"; break;
+            case TYPE_UNKNOWN: note = " (never assigned)"; break;
+            default: break;
+        }
+        fprintf(report, "  %-16s %s%s\n", interpreter->symbols.names[slot], type_name(inference->types[slot]), note);
+    }
+}
+
+void infer_types(Interpreter* interpreter, ASTNode* ast, FILE* report) {
+    infer_types_with_inputs(interpreter, ast, NULL, 0, report);
+}
+
+void infer_types_with_inputs(Interpreter* interpreter, ASTNode* ast, const int* inputs, int input_count, FILE* report) {
+    Inference inference;
+    inference.count = interpreter->symbols.count;
+    // 変数が 0 個でも NULL（未推論）にならないよう 1 バイト多く取る
+    Allocator* allocator = interpreter->allocator;
+    inference.types = allocator_calloc(allocator, (size_t)inference.count + 1, 1, ALLOC_VARIABLES);
+    inference.shared = allocator_calloc(allocator, (size_t)inference.count + 1, 1, ALLOC_VARIABLES);
+    for (int i = 0; i < input_count; i++)
+        if (inputs[i] >= 0 && inputs[i] < inference.count) inference.types[inputs[i]] = TYPE_DYNAMIC;
+    // 変数の型が増えると、それを参照する式の型も変わりうるので不動点まで繰り返す
+    do {
+        inference.changed = 0;
+        infer_statement(&inference, ast);
+    } while (inference.changed);
+
+    if (report) report_types(interpreter, &inference, report);
+    if (interpreter->slot_types)
+        allocator_free(allocator, interpreter->slot_types, (size_t)interpreter->slot_type_count + 1, ALLOC_VARIABLES);
+    interpreter->slot_types = inference.types;
+    interpreter->slot_type_count = inference.count;
+    allocator_free(allocator, inference.shared, (size_t)inference.count + 1, ALLOC_VARIABLES);
+}
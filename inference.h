@@ -0,0 +1,15 @@
+#ifndef INFERENCE_H
+#define INFERENCE_H
+
+#include <stdio.h>
+#include "interpreter.h"
+
+// スクリプト全体（カテゴリ本体を含む）から変数ごとの型を推論し、interpreter->slot_types に書き込む。
+// 常に数値と証明された変数はタグなしの double 配列に置かれる。
+// 後から別のコードが同じ Interpreter で実行されると成り立たないので、単一のスクリプトにだけ使う。
+// report が NULL でなければ推論結果をそこへ書き出す
+void infer_types(Interpreter* interpreter, ASTNode* ast, FILE* report);
+// inputs のスロットには実行前に外から任意の型の値が入るので、最初から動的として扱う
+void infer_types_with_inputs(Interpreter* interpreter, ASTNode* ast, const int* inputs, int input_count, FILE* report);
+
+#endif
@@ -2,7 +2,13 @@
 #include <stdlib.h>
 #include <string.h>
 #include <math.h>
+#include <limits.h>
 #include "interpreter.h"
+#include "output.h"
+#include "stats.h"
+#include "profile.h"
+#include "parallel.h"
+#include "pyworker.h"
 
 EvalResult create_number_result(double value) {
     EvalResult result;
@@ -11,276 +17,619 @@ EvalResult create_number_result(double value) {
     return result;
 }
 
-EvalResult create_string_result(const char* value) {
+EvalResult create_string_result(RString* value) {
     EvalResult result;
     result.type = RESULT_STRING;
-    result.value.string = strdup(value);
+    result.value.string = value;
     return result;
 }
 
-void variable_table_expand(VariableTable* table) {
-    table->capacity *= 2;
-    table->variables = realloc(table->variables, sizeof(Variable) * table->capacity);
+EvalResult create_chars_result(Allocator* allocator, const char* chars, int length) {
+    if (length > SHORT_STRING_MAX) return create_string_result(rstring_new(allocator, chars, length));
+    EvalResult result;
+    result.type = RESULT_SHORT_STRING;
+    memcpy(result.value.short_string, chars, (size_t)length);
+    result.value.short_string[length] = '\0';
+    result.short_length = length;
+    return result;
+}
+
+EvalResult create_cstring_result(Allocator* allocator, const char* value) {
+    return create_chars_result(allocator, value, (int)strlen(value));
+}
+
+EvalResult share_string_result(RString* value) {
+    if (value->length <= SHORT_STRING_MAX) return create_chars_result(value->allocator, value->chars, value->length);
+    return create_string_result(rstring_retain(value));
+}
+
+EvalResult retain_result(EvalResult result) {
+    if (result.type == RESULT_STRING) rstring_retain(result.value.string);
+    return result;
+}
+
+void release_result(EvalResult result) {
+    if (result.type == RESULT_STRING) rstring_release(result.value.string);
+}
+
+// 変数表はスロット番号で直接引く。スロットは Interpreter の記号表が割り当てる
+static void variable_table_init(VariableTable* table, Allocator* allocator) {
+    table->count = 0;
+    table->capacity = 16;
+    table->variables = allocator_calloc(allocator, table->capacity, sizeof(Variable), ALLOC_VARIABLES);
+}
+
+static void variable_table_reserve(VariableTable* table, int slots, Allocator* allocator) {
+    if (slots <= table->capacity) return;
+    int old_capacity = table->capacity;
+    while (table->capacity < slots) table->capacity *= 2;
+    table->variables = allocator_realloc(allocator, table->variables, sizeof(Variable) * old_capacity,
+                                         sizeof(Variable) * table->capacity, ALLOC_VARIABLES);
+    memset(table->variables + old_capacity, 0, sizeof(Variable) * (table->capacity - old_capacity));
+}
+
+static void variable_table_free(VariableTable* table, Allocator* allocator) {
+    for (int i = 0; i < table->capacity; i++)
+        if (table->variables[i].type == VAR_STRING) rstring_release(table->variables[i].value.string);
+    allocator_free(allocator, table->variables, sizeof(Variable) * table->capacity, ALLOC_VARIABLES);
+}
+
+// prun のワーカーは起動元の記号表・カテゴリ表を構造体ごと写して同じ配列を読むだけなので、
+// 名前を増やすと起動元の配列を付け替えてしまう。ワーカーでは既にある名前だけを引き、新しい名前はエラーにする
+static int worker_lookup(Interpreter* worker, const SymbolTable* table, const char* kind, const char* name) {
+    int slot = symbol_lookup(table, name);
+    if (slot < 0) output_error(&worker->errors, "Runtime error: Cannot add %s '%s' inside prun\n", kind, name);
+    return slot;
+}
+
+int interpreter_intern_category(Interpreter* interpreter, const char* name) {
+    if (interpreter->parent) return worker_lookup(interpreter, &interpreter->category_names, "category", name);
+    int slot = symbol_intern(&interpreter->category_names, name);
+    if (slot >= interpreter->category_capacity) {
+        int old_capacity = interpreter->category_capacity;
+        while (interpreter->category_capacity <= slot) interpreter->category_capacity *= 2;
+        interpreter->categories = allocator_realloc(interpreter->allocator, interpreter->categories,
+                                                    sizeof(Category) * old_capacity,
+                                                    sizeof(Category) * interpreter->category_capacity, ALLOC_CATEGORIES);
+        memset(interpreter->categories + old_capacity, 0, sizeof(Category) * (interpreter->category_capacity - old_capacity));
+    }
+    interpreter->categories[slot].name = interpreter->category_names.names[slot];
+    return slot;
+}
+
+static void mark_number_undefined(double* value) {
+    uint64_t bits = UNDEFINED_NUMBER_BITS;
+    memcpy(value, &bits, sizeof(bits));
+}
+
+int interpreter_intern(Interpreter* interpreter, const char* name) {
+    if (interpreter->parent) return worker_lookup(interpreter, &interpreter->symbols, "variable", name);
+    int slot = symbol_intern(&interpreter->symbols, name);
+    int old_capacity = interpreter->variables.capacity;
+    variable_table_reserve(&interpreter->variables, interpreter->symbols.count, interpreter->allocator);
+    variable_table_reserve(&interpreter->shared_variables, interpreter->symbols.count, interpreter->allocator);
+    if (interpreter->variables.capacity != old_capacity) {
+        interpreter->numbers = allocator_realloc(interpreter->allocator, interpreter->numbers, sizeof(double) * old_capacity,
+                                                 sizeof(double) * interpreter->variables.capacity, ALLOC_VARIABLES);
+        for (int i = old_capacity; i < interpreter->variables.capacity; i++) mark_number_undefined(&interpreter->numbers[i]);
+    }
+    return slot;
+}
+
+void set_variable_internal(Interpreter* interpreter, VariableTable* table, int slot, EvalResult result, int is_shared) {
+    Variable* var = &table->variables[slot];
+    if (var->type == VAR_UNDEFINED) {
+        var->name = interpreter->symbols.names[slot];
+        var->is_shared = is_shared;
+        __atomic_fetch_add(&table->count, 1, __ATOMIC_RELAXED);    // 共有変数表は prun のワーカーが並行して増やす
+    } else if (var->type == VAR_STRING) {
+        rstring_release(var->value.string);
+    }
+    switch (result.type) {
+        case RESULT_NUMBER: var->type = VAR_NUMBER; var->value.number = result.value.number; break;
+        case RESULT_STRING: var->type = VAR_STRING; var->value.string = result.value.string; break;
+        case RESULT_SHORT_STRING:
+            var->type = VAR_SHORT_STRING;
+            memcpy(var->value.short_string, result.value.short_string, sizeof(var->value.short_string));
+            var->short_length = result.short_length;
+            break;
+    }
+}
+
+// 変数の値を新しい参照として取り出す
+static EvalResult variable_to_result(const Variable* var) {
+    EvalResult result;
+    switch (var->type) {
+        case VAR_STRING: return create_string_result(rstring_retain(var->value.string));
+        case VAR_SHORT_STRING:
+            result.type = RESULT_SHORT_STRING;
+            memcpy(result.value.short_string, var->value.short_string, sizeof(result.value.short_string));
+            result.short_length = var->short_length;
+            return result;
+        default: return create_number_result(var->value.number);
+    }
 }
 
-Variable* find_variable(VariableTable* table, const char* name) {
-    for (int i = 0; i < table->count; i++)
-        if (strcmp(table->variables[i].name, name) == 0)
-            return &table->variables[i];
+// --- Scopes ---
+// prun のワーカーは自分の表になければ起動元の文脈を順にさかのぼる（起動元は合流を待っていて書き換えない）
+static Variable* find_local_variable(Interpreter* interpreter, int slot) {
+    for (; interpreter; interpreter = interpreter->parent) {
+        Variable* var = &interpreter->variables.variables[slot];
+        if (var->type != VAR_UNDEFINED) return var;
+    }
     return NULL;
 }
 
-void set_variable_internal(VariableTable* table, const char* name, EvalResult result, int is_shared) {
-    Variable* var = find_variable(table, name);
+// 共有変数表は最上位の文脈だけが持つ。ワーカーからはスロットのロックを取って触る
+static VariableTable* shared_table(Interpreter* interpreter) {
+    while (interpreter->parent) interpreter = interpreter->parent;
+    return &interpreter->shared_variables;
+}
+
+static void store_shared_variable(Interpreter* interpreter, int slot, EvalResult result) {
+    if (interpreter->parent) parallel_lock_slot(slot);
+    set_variable_internal(interpreter, shared_table(interpreter), slot, result, 1);
+    if (interpreter->parent) parallel_unlock_slot(slot);
+}
+
+// 共有変数の値を新しい参照として読む（result が NULL なら有無だけ調べる）。未定義なら 0 を返す
+static int load_shared_variable(Interpreter* interpreter, int slot, EvalResult* result) {
+    if (interpreter->parent) parallel_lock_slot(slot);
+    Variable* var = &shared_table(interpreter)->variables[slot];
+    int defined = var->type != VAR_UNDEFINED;
+    if (defined && result) *result = variable_to_result(var);
+    if (interpreter->parent) parallel_unlock_slot(slot);
+    return defined;
+}
+
+// 変数の値を新しい参照として読む。未定義なら 0 を返す
+static int load_variable_slot(Interpreter* interpreter, int slot, EvalResult* result) {
+    if (interpreter_slot_is_number(interpreter, slot) && number_slot_defined(&interpreter->numbers[slot])) {
+        *result = create_number_result(interpreter->numbers[slot]);
+        return 1;
+    }
+    Variable* var = find_local_variable(interpreter, slot);
     if (var) {
-        if (var->type == VAR_STRING && var->value.string != NULL) free(var->value.string);
-        switch (result.type) {
-            case RESULT_NUMBER: var->type = VAR_NUMBER; var->value.number = result.value.number; break;
-            case RESULT_STRING: var->type = VAR_STRING; var->value.string = strdup(result.value.string); break;
-        }
-    } else {
-        if (table->count >= table->capacity) variable_table_expand(table);
-        var = &table->variables[table->count++];
-        var->name = strdup(name);
-        var->is_shared = is_shared;
-        switch (result.type) {
-            case RESULT_NUMBER: var->type = VAR_NUMBER; var->value.number = result.value.number; break;
-            case RESULT_STRING: var->type = VAR_STRING; var->value.string = strdup(result.value.string); break;
+        *result = variable_to_result(var);
+        return 1;
+    }
+    return load_shared_variable(interpreter, slot, result);
+}
+
+// 数値と証明されたスロットはタグなしの numbers に直接置く
+void set_number_slot(Interpreter* interpreter, int slot, double value) {
+    double* number = &interpreter->numbers[slot];
+    if (!number_slot_defined(number)) interpreter->variables.count++;
+    *number = value;
+}
+
+void reassign_number_slot(Interpreter* interpreter, int slot, double value) {
+    double* number = &interpreter->numbers[slot];
+    if (number_slot_defined(number)) *number = value;
+    else output_error(&interpreter->errors, "Runtime error: Attempted 're' assignment to undeclared variable '%s'\n", interpreter->symbols.names[slot]);
+}
+
+void set_variable_slot(Interpreter* interpreter, int slot, EvalResult result, int is_shared) {
+    if (interpreter_slot_is_number(interpreter, slot)) {
+        if (result.type == RESULT_NUMBER) set_number_slot(interpreter, slot, result.value.number);
+        else {
+            output_error(&interpreter->errors, "Runtime error: Variable '%s' was inferred to be a number\n", interpreter->symbols.names[slot]);
+            release_result(result);
         }
+        return;
     }
+    if (is_shared) store_shared_variable(interpreter, slot, result);
+    else set_variable_internal(interpreter, &interpreter->variables, slot, result, is_shared);
 }
 
 void set_variable(Interpreter* interpreter, const char* name, EvalResult result, int is_shared) {
-    if (is_shared) set_variable_internal(&interpreter->shared_variables, name, result, is_shared);
-    else set_variable_internal(&interpreter->variables, name, result, is_shared);
+    int slot = interpreter_intern(interpreter, name);
+    if (slot < 0) { release_result(result); return; }
+    set_variable_slot(interpreter, slot, result, is_shared);
 }
 
+// 変数の中身を直接指すので、prun の実行中に共有変数を読むには使えない
+Variable* get_variable_slot(Interpreter* interpreter, int slot) {
+    Variable* var = &interpreter->variables.variables[slot];
+    if (interpreter_slot_is_number(interpreter, slot)) {
+        // 名前で引く側には Variable の形に写して返す
+        if (!number_slot_defined(&interpreter->numbers[slot])) return NULL;
+        var->name = interpreter->symbols.names[slot];
+        var->type = VAR_NUMBER;
+        var->value.number = interpreter->numbers[slot];
+        return var;
+    }
+    var = find_local_variable(interpreter, slot);
+    if (var) return var;
+    var = &shared_table(interpreter)->variables[slot];
+    if (var->type != VAR_UNDEFINED) return var;
+    return NULL;
+}
+
+// 名前からの参照（REPLや埋め込み側から）はハッシュ表で引く
 Variable* get_variable(Interpreter* interpreter, const char* name) {
-    Variable* var = find_variable(&interpreter->variables, name);
-    if (!var) var = find_variable(&interpreter->shared_variables, name);
-    return var;
+    int slot = symbol_lookup(&interpreter->symbols, name);
+    if (slot < 0) return NULL;
+    return get_variable_slot(interpreter, slot);
 }
 
-void set_shared_variable(Interpreter* interpreter, const char* name) {
-    Variable* local_var = find_variable(&interpreter->variables, name);
-    if (local_var) {
-        if (local_var->type == VAR_STRING) {
-            EvalResult result = create_string_result(local_var->value.string);
-            set_variable_internal(&interpreter->shared_variables, name, result, 1);
-            free(result.value.string);
-        } else {
-            EvalResult result = create_number_result(local_var->value.number);
-            set_variable_internal(&interpreter->shared_variables, name, result, 1);
-        }
+void reassign_variable_slot(Interpreter* interpreter, int slot, EvalResult result) {
+    if (interpreter_slot_is_number(interpreter, slot) && result.type == RESULT_NUMBER) {
+        reassign_number_slot(interpreter, slot, result.value.number);
+        return;
     }
+    // ローカル（ワーカーでは起動元の分も含む）にあれば自分の表へ、共有変数だけなら共有変数表へ書く。
+    // 共有変数は定義されたら消えないので、確かめてから書くまでの間に未定義へ戻ることはない
+    if ((interpreter_slot_is_number(interpreter, slot) && number_slot_defined(&interpreter->numbers[slot]))
+        || find_local_variable(interpreter, slot)) {
+        set_variable_slot(interpreter, slot, result, 0);
+        return;
+    }
+    if (load_shared_variable(interpreter, slot, NULL)) {
+        set_variable_slot(interpreter, slot, result, 1);
+        return;
+    }
+    output_error(&interpreter->errors, "Runtime error: Attempted 're' assignment to undeclared variable '%s'\n", interpreter->symbols.names[slot]);
+    release_result(result);
 }
 
-Interpreter* interpreter_create() {
-    Interpreter* interpreter = malloc(sizeof(Interpreter));
-    interpreter->variables.variables = malloc(sizeof(Variable) * 10);
-    interpreter->variables.count = 0;
-    interpreter->variables.capacity = 10;
-    interpreter->shared_variables.variables = malloc(sizeof(Variable) * 10);
-    interpreter->shared_variables.count = 0;
-    interpreter->shared_variables.capacity = 10;
-    interpreter->categories = NULL;
+void reassign_variable(Interpreter* interpreter, const char* name, EvalResult result) {
+    int slot = interpreter_intern(interpreter, name);
+    if (slot < 0) { release_result(result); return; }
+    reassign_variable_slot(interpreter, slot, result);
+}
+
+void set_shared_variable_slot(Interpreter* interpreter, int slot) {
+    Variable* local_var = find_local_variable(interpreter, slot);
+    if (local_var) store_shared_variable(interpreter, slot, variable_to_result(local_var));
+}
+
+void set_shared_variable(Interpreter* interpreter, const char* name) {
+    int slot = interpreter_intern(interpreter, name);
+    if (slot >= 0) set_shared_variable_slot(interpreter, slot);
+}
+
+EvalResult evaluate_variable_slot(Interpreter* interpreter, int slot) {
+    EvalResult result;
+    if (load_variable_slot(interpreter, slot, &result)) return result;
+    output_error(&interpreter->errors, "Runtime error: Undefined variable '%s'\n", interpreter->symbols.names[slot]);
+    return create_number_result(0);
+}
+
+Interpreter* interpreter_create(Allocator* allocator) {
+    Interpreter* interpreter = allocator_alloc(allocator, sizeof(Interpreter), ALLOC_VARIABLES);
+    interpreter->allocator = allocator;
+    symbol_table_init(&interpreter->symbols, allocator, ALLOC_VARIABLES);
+    variable_table_init(&interpreter->variables, allocator);
+    variable_table_init(&interpreter->shared_variables, allocator);
+    interpreter->numbers = allocator_alloc(allocator, sizeof(double) * interpreter->variables.capacity, ALLOC_VARIABLES);
+    for (int i = 0; i < interpreter->variables.capacity; i++) mark_number_undefined(&interpreter->numbers[i]);
+    interpreter->slot_types = NULL;
+    interpreter->slot_type_count = 0;
+    symbol_table_init(&interpreter->category_names, allocator, ALLOC_CATEGORIES);
+    interpreter->category_capacity = 16;
+    interpreter->category_definitions = 0;
+    interpreter->statement_markers = 0;
+    interpreter->profile = NULL;
+    interpreter->parent = NULL;
+    interpreter->output = output_stdout_sink();
+    interpreter->errors = output_stderr_sink();
+    interpreter->categories = allocator_calloc(allocator, interpreter->category_capacity, sizeof(Category), ALLOC_CATEGORIES);
     return interpreter;
 }
 
+void interpreter_drop_category_history(Interpreter* interpreter) {
+    for (int i = 0; i < interpreter->category_capacity; i++) {
+        Category* old = interpreter->categories[i].previous;
+        while (old != NULL) {
+            Category* previous = old->previous;
+            allocator_free(interpreter->allocator, old, sizeof(Category), ALLOC_CATEGORIES);
+            old = previous;
+        }
+        interpreter->categories[i].previous = NULL;
+    }
+}
+
 void interpreter_free(Interpreter* interpreter) {
     if (!interpreter) return;
-    for (int i = 0; i < interpreter->variables.count; i++) {
-        free(interpreter->variables.variables[i].name);
-        if (interpreter->variables.variables[i].type == VAR_STRING)
-            free(interpreter->variables.variables[i].value.string);
+    Allocator* allocator = interpreter->allocator;
+    variable_table_free(&interpreter->variables, allocator);
+    variable_table_free(&interpreter->shared_variables, allocator);
+    allocator_free(allocator, interpreter->numbers, sizeof(double) * interpreter->variables.capacity, ALLOC_VARIABLES);
+    if (interpreter->slot_types)
+        allocator_free(allocator, interpreter->slot_types, (size_t)interpreter->slot_type_count + 1, ALLOC_VARIABLES);
+    interpreter_drop_category_history(interpreter);
+    allocator_free(allocator, interpreter->categories, sizeof(Category) * interpreter->category_capacity, ALLOC_CATEGORIES);
+    symbol_table_free(&interpreter->category_names);
+    symbol_table_free(&interpreter->symbols);
+    allocator_free(allocator, interpreter, sizeof(Interpreter), ALLOC_VARIABLES);
+}
+
+Interpreter* interpreter_create_worker(Interpreter* parent) {
+    Allocator* allocator = parent->allocator;
+    Interpreter* worker = allocator_alloc(allocator, sizeof(Interpreter), ALLOC_VARIABLES);
+    // 共有変数表は他のワーカーが書き換えているので写さない（shared_table() で最上位のものを使う）
+    memset(worker, 0, sizeof(Interpreter));
+    worker->allocator = allocator;
+    worker->symbols = parent->symbols;
+    worker->variables.capacity = parent->variables.capacity;
+    worker->variables.variables = allocator_calloc(allocator, worker->variables.capacity, sizeof(Variable), ALLOC_VARIABLES);
+    worker->numbers = allocator_alloc(allocator, sizeof(double) * worker->variables.capacity, ALLOC_VARIABLES);
+    memcpy(worker->numbers, parent->numbers, sizeof(double) * worker->variables.capacity);
+    worker->slot_types = parent->slot_types;
+    worker->slot_type_count = parent->slot_type_count;
+    worker->category_names = parent->category_names;
+    worker->categories = parent->categories;
+    worker->category_capacity = parent->category_capacity;
+    worker->statement_markers = parent->statement_markers;
+    worker->parent = parent;
+    worker->output = parent->output;
+    worker->errors = parent->errors;
+    return worker;
+}
+
+void interpreter_free_worker(Interpreter* worker) {
+    Allocator* allocator = worker->allocator;
+    variable_table_free(&worker->variables, allocator);
+    allocator_free(allocator, worker->numbers, sizeof(double) * worker->variables.capacity, ALLOC_VARIABLES);
+    allocator_free(allocator, worker, sizeof(Interpreter), ALLOC_VARIABLES);
+}
+
+// left の参照を消費して末尾に chars を足す。
+// 短ければインラインに収め、ヒープ上の一時値ならその場で伸ばす
+EvalResult concat_string_result(Allocator* allocator, EvalResult left, const char* chars, int length) {
+    if (left.type == RESULT_STRING) return create_string_result(rstring_append(left.value.string, chars, length));
+    char l_buf[100];
+    const char* l_str;
+    int l_len;
+    if (left.type == RESULT_NUMBER) { l_len = output_format_number(l_buf, left.value.number); l_str = l_buf; }
+    else { l_len = left.short_length; l_str = left.value.short_string; }
+    if (l_len + length <= SHORT_STRING_MAX) {
+        EvalResult result;
+        result.type = RESULT_SHORT_STRING;
+        memcpy(result.value.short_string, l_str, (size_t)l_len);
+        memcpy(result.value.short_string + l_len, chars, (size_t)length);
+        result.value.short_string[l_len + length] = '\0';
+        result.short_length = l_len + length;
+        return result;
+    }
+    return create_string_result(rstring_concat(allocator, l_str, l_len, chars, length));
+}
+
+int string_results_equal(const EvalResult* left, const EvalResult* right) {
+    if (left->type == RESULT_STRING && right->type == RESULT_STRING)
+        return rstring_equals(left->value.string, right->value.string);
+    int length = result_length(left);
+    return length == result_length(right) && memcmp(result_chars(left), result_chars(right), (size_t)length) == 0;
+}
+
+EvalResult apply_binary_op(Allocator* allocator, const OutputSink* errors, TokenType op, EvalResult left, EvalResult right) {
+    // 数値同士
+    if (left.type == RESULT_NUMBER && right.type == RESULT_NUMBER) {
+        double l = left.value.number, r = right.value.number, res = 0; int comparison = 0;
+        switch (op) {
+            case TOKEN_PLUS: res = l + r; break;
+            case TOKEN_MINUS: res = l - r; break;
+            case TOKEN_MULTIPLY: res = l * r; break;
+            case TOKEN_DIVIDE: if (r != 0) res = l / r; else { output_error(errors, "Runtime error: Division by zero\n"); res = 0;} break;
+            case TOKEN_AT: res = l * r; break;
+            case TOKEN_YEN:
+            case TOKEN_BACKSLASH: if (r != 0) res = l / r; else { output_error(errors, "Runtime error: Division by zero\n"); res = 0;} break;
+            case TOKEN_MOD: res = fmod(l, r); break;
+            case TOKEN_GT: comparison = (l > r); break;
+            case TOKEN_LT: comparison = (l < r); break;
+            case TOKEN_GTE: comparison = (l >= r); break;
+            case TOKEN_LTE: comparison = (l <= r); break;
+            case TOKEN_EQ: comparison = (l == r); break;
+            case TOKEN_NEQ: comparison = (l != r); break;
+            case TOKEN_AMPERSAND: comparison = (l != 0 && r != 0); break;
+            case TOKEN_PIPE: comparison = (l != 0 || r != 0); break;
+            default: output_error(errors, "Runtime error: Unsupported binary operator on numbers\n"); break;
+        }
+        if (op >= TOKEN_GT && op <= TOKEN_PIPE)
+            return create_number_result(comparison ? 1.0 : 0.0);
+        return create_number_result(res);
+    }
+    // 文字列の連結（数値は文字列に変換する）
+    if (op == TOKEN_PLUS) {
+        char r_buf[100];
+        const char* r_str;
+        int r_len;
+        if (right.type == RESULT_NUMBER) { r_len = output_format_number(r_buf, right.value.number); r_str = r_buf; }
+        else { r_len = result_length(&right); r_str = result_chars(&right); }
+        EvalResult joined = concat_string_result(allocator, left, r_str, r_len);
+        release_result(right);
+        return joined;
+    }
+    // 文字列同士の比較
+    if (left.type != RESULT_NUMBER && right.type != RESULT_NUMBER) {
+        int result = 0;
+        switch (op) {
+            case TOKEN_EQ:  result = string_results_equal(&left, &right); break;
+            case TOKEN_NEQ: result = !string_results_equal(&left, &right); break;
+            case TOKEN_GT:  result = (strcmp(result_chars(&left), result_chars(&right)) > 0); break;
+            case TOKEN_LT:  result = (strcmp(result_chars(&left), result_chars(&right)) < 0); break;
+            case TOKEN_GTE: result = (strcmp(result_chars(&left), result_chars(&right)) >= 0); break;
+            case TOKEN_LTE: result = (strcmp(result_chars(&left), result_chars(&right)) <= 0); break;
+            default:
+                output_error(errors, "Runtime error: Unsupported binary operator on strings\n");
+                break;
+        }
+        release_result(left);
+        release_result(right);
+        return create_number_result(result ? 1.0 : 0.0);
+    }
+    output_error(errors, "Runtime error: Unsupported binary operator on strings\n");
+    release_result(left);
+    release_result(right);
+    return create_number_result(0);
+}
+
+EvalResult apply_unary_op(const OutputSink* errors, TokenType op, EvalResult operand) {
+    if (operand.type == RESULT_NUMBER) {
+        double val = operand.value.number, res = 0;
+        switch (op) {
+            case TOKEN_PLUS: res = val; break;
+            case TOKEN_MINUS: res = -val; break;
+            case TOKEN_TILDE: res = (val == 0.0) ? 1.0 : 0.0; break;
+            default: output_error(errors, "Runtime error: Unsupported unary operator on number\n"); break;
+        }
+        return create_number_result(res);
     }
-    free(interpreter->variables.variables);
-    for (int i = 0; i < interpreter->shared_variables.count; i++) {
-        free(interpreter->shared_variables.variables[i].name);
-        if (interpreter->shared_variables.variables[i].type == VAR_STRING)
-            free(interpreter->shared_variables.variables[i].value.string);
+    if (op == TOKEN_TILDE) {
+        double res = (result_length(&operand) == 0) ? 1.0 : 0.0;
+        release_result(operand);
+        return create_number_result(res);
     }
-    free(interpreter->shared_variables.variables);
-    Category* current_cat = interpreter->categories;
-    while (current_cat != NULL) {
-        Category* next_cat = current_cat->next;
-        free(current_cat->name);
-        free(current_cat->statements);
-        free(current_cat);
-        current_cat = next_cat;
+    output_error(errors, "Runtime error: Unsupported unary operator on string\n");
+    release_result(operand);
+    return create_number_result(0);
+}
+
+// 条件の真偽判定（resultの所有権は移らない）
+int result_is_truthy(EvalResult result) {
+    if (result.type == RESULT_NUMBER) return result.value.number != 0;
+    return result_length(&result) > 0;
+}
+
+void write_result(Interpreter* interpreter, EvalResult result) {
+    if (result.type != RESULT_NUMBER) output_line(&interpreter->output, result_chars(&result), (size_t)result_length(&result));
+    else output_number_line(&interpreter->output, result.value.number);
+}
+
+void write_variable_slot(Interpreter* interpreter, int slot) {
+    EvalResult value;
+    if (load_variable_slot(interpreter, slot, &value)) {
+        write_result(interpreter, value);
+        release_result(value);
+    } else {
+        output_error(&interpreter->errors, "Runtime error: Undefined variable '%s' for 'num write'\n", interpreter->symbols.names[slot]);
     }
-    free(interpreter);
 }
 
 EvalResult evaluate_expression(Interpreter* interpreter, ASTNode* node) {
     if (!node) return create_number_result(0);
     switch (node->type) {
         case AST_NUMBER: return create_number_result(node->data.number.value);
-        case AST_STRING: return create_string_result(node->data.string.value);
-        case AST_IDENTIFIER: {
-            Variable* var = get_variable(interpreter, node->data.identifier.name);
-            if (var) {
-                if (var->type == VAR_NUMBER)
-                    return create_number_result(var->value.number);
-                else if (var->type == VAR_STRING)
-                    return create_string_result(var->value.string);
-            }
-            fprintf(stderr, "Runtime error: Undefined variable '%s'\n", node->data.identifier.name);
-            return create_number_result(0);
-        }
+        case AST_STRING: return share_string_result(node->data.string.value);
+        case AST_IDENTIFIER: return evaluate_variable_slot(interpreter, node->data.identifier.slot);
         case AST_BINARY_OP: {
             EvalResult left = evaluate_expression(interpreter, node->data.binary_op.left);
             EvalResult right = evaluate_expression(interpreter, node->data.binary_op.right);
-
-            // 数値同士
-            if (left.type == RESULT_NUMBER && right.type == RESULT_NUMBER) {
-                double l = left.value.number, r = right.value.number, res = 0; int comparison = 0;
-                switch (node->data.binary_op.operator) {
-                    case TOKEN_PLUS: res = l + r; break;
-                    case TOKEN_MINUS: res = l - r; break;
-                    case TOKEN_MULTIPLY: res = l * r; break;
-                    case TOKEN_DIVIDE: if (r != 0) res = l / r; else { fprintf(stderr, "Runtime error: Division by zero\n"); res = 0;} break;
-                    case TOKEN_AT: res = l * r; break;
-                    case TOKEN_YEN:
-                    case TOKEN_BACKSLASH: if (r != 0) res = l / r; else { fprintf(stderr, "Runtime error: Division by zero\n"); res = 0;} break;
-                    case TOKEN_MOD: res = fmod(l, r); break;
-                    case TOKEN_GT: comparison = (l > r); break;
-                    case TOKEN_LT: comparison = (l < r); break;
-                    case TOKEN_GTE: comparison = (l >= r); break;
-                    case TOKEN_LTE: comparison = (l <= r); break;
-                    case TOKEN_EQ: comparison = (l == r); break;
-                    case TOKEN_NEQ: comparison = (l != r); break;
-                    case TOKEN_AMPERSAND: comparison = (l != 0 && r != 0); break;
-                    case TOKEN_PIPE: comparison = (l != 0 || r != 0); break;
-                    default: fprintf(stderr, "Runtime error: Unsupported binary operator on numbers\n"); break;
-                }
-                if (node->data.binary_op.operator >= TOKEN_GT && node->data.binary_op.operator <= TOKEN_PIPE)
-                    return create_number_result(comparison ? 1.0 : 0.0);
-                return create_number_result(res);
-            }
-            // 文字列同士
-            else if (left.type == RESULT_STRING && right.type == RESULT_STRING) {
-                int cmp = strcmp(left.value.string, right.value.string);
-                int result = 0;
-                switch (node->data.binary_op.operator) {
-                    case TOKEN_EQ:  result = (cmp == 0); break;
-                    case TOKEN_NEQ: result = (cmp != 0); break;
-                    case TOKEN_GT:  result = (cmp > 0); break;
-                    case TOKEN_LT:  result = (cmp < 0); break;
-                    case TOKEN_GTE: result = (cmp >= 0); break;
-                    case TOKEN_LTE: result = (cmp <= 0); break;
-                    case TOKEN_PLUS: {
-                        // 文字列連結
-                        size_t len = strlen(left.value.string) + strlen(right.value.string) + 1;
-                        char* result_str = malloc(len);
-                        strcpy(result_str, left.value.string);
-                        strcat(result_str, right.value.string);
-                        free(left.value.string);
-                        free(right.value.string);
-                        EvalResult result_ret = create_string_result(result_str);
-                        free(result_str);
-                        return result_ret;
-                    }
-                    default:
-                        fprintf(stderr, "Runtime error: Unsupported binary operator on strings\n");
-                        free(left.value.string);
-                        free(right.value.string);
-                        return create_number_result(0);
-                }
-                free(left.value.string);
-                free(right.value.string);
-                return create_number_result(result ? 1.0 : 0.0);
-            }
-            // 片方が文字列
-            else if (left.type == RESULT_STRING || right.type == RESULT_STRING) {
-                if (node->data.binary_op.operator == TOKEN_PLUS) {
-                    char l_str_buf[100], r_str_buf[100], *l_str, *r_str;
-                    if (left.type == RESULT_NUMBER) { sprintf(l_str_buf, "%g", left.value.number); l_str = l_str_buf;} else { l_str = left.value.string;}
-                    if (right.type == RESULT_NUMBER) { sprintf(r_str_buf, "%g", right.value.number); r_str = r_str_buf;} else { r_str = right.value.string;}
-                    size_t len = strlen(l_str) + strlen(r_str) + 1;
-                    char* result_str = malloc(len);
-                    strcpy(result_str, l_str); strcat(result_str, r_str);
-                    if (left.type == RESULT_STRING) free(left.value.string);
-                    if (right.type == RESULT_STRING) free(right.value.string);
-                    EvalResult result = create_string_result(result_str);
-                    free(result_str);
-                    return result;
-                } else {
-                    fprintf(stderr, "Runtime error: Unsupported binary operator on strings\n");
-                    if (left.type == RESULT_STRING) free(left.value.string);
-                    if (right.type == RESULT_STRING) free(right.value.string);
-                    return create_number_result(0);
-                }
-            }
-            return create_number_result(0);
-        }
-        case AST_UNARY_OP: {
-            EvalResult operand = evaluate_expression(interpreter, node->data.unary_op.operand);
-            if (operand.type == RESULT_NUMBER) {
-                double val = operand.value.number, res = 0;
-                switch (node->data.unary_op.operator) {
-                    case TOKEN_PLUS: res = val; break;
-                    case TOKEN_MINUS: res = -val; break;
-                    case TOKEN_TILDE: res = (val == 0.0) ? 1.0 : 0.0; break;
-                    default: fprintf(stderr, "Runtime error: Unsupported unary operator on number\n"); break;
-                }
-                return create_number_result(res);
-            } else if (operand.type == RESULT_STRING) {
-                if (node->data.unary_op.operator == TOKEN_TILDE) {
-                    double res = (strlen(operand.value.string) == 0) ? 1.0 : 0.0;
-                    free(operand.value.string);
-                    return create_number_result(res);
-                }
-                fprintf(stderr, "Runtime error: Unsupported unary operator on string\n");
-                free(operand.value.string);
-                return create_number_result(0);
-            }
+            return apply_binary_op(interpreter->allocator, &interpreter->errors, node->data.binary_op.operator, left, right);
         }
+        case AST_UNARY_OP:
+            return apply_unary_op(&interpreter->errors, node->data.unary_op.operator, evaluate_expression(interpreter, node->data.unary_op.operand));
+        case AST_CALL_EXPRESSION:
+            return evaluate_external_code(interpreter, node->data.call_statement.language, node->data.call_statement.code);
         default:
-            fprintf(stderr, "Runtime error: Cannot evaluate AST type %d as expression\n", node->type);
+            output_error(&interpreter->errors, "Runtime error: Cannot evaluate AST type %d as expression\n", node->type);
             return create_number_result(0);
     }
 }
 
+void define_category_slot(Interpreter* interpreter, int slot, ASTNode** statements, int count, struct Function* function) {
+    Category* category = &interpreter->categories[slot];
+    // カテゴリ表は prun のワーカーが並行して読むので書き換えさせない
+    if (interpreter->parent) {
+        output_error(&interpreter->errors, "Runtime error: Cannot define category '%s' inside prun\n", category->name);
+        return;
+    }
+    // 同じ本体の定義し直し（ループ内のカテゴリ定義など）は履歴を積まない
+    if (category->defined && category->statements == statements && category->function == function) {
+        interpreter->category_definitions++;
+        return;
+    }
+    if (category->defined) {
+        Category* old = allocator_alloc(interpreter->allocator, sizeof(Category), ALLOC_CATEGORIES);
+        *old = *category;
+        category->previous = old;
+    }
+    category->defined = 1;
+    interpreter->category_definitions++;
+    category->statements = statements;
+    category->statement_count = count;
+    category->function = function;
+}
+
 void define_category(Interpreter* interpreter, const char* name, ASTNode** statements, int count) {
-    Category* new_category = malloc(sizeof(Category));
-    new_category->name = strdup(name);
-    new_category->statements = statements;
-    new_category->statement_count = count;
-    new_category->next = interpreter->categories;
-    interpreter->categories = new_category;
+    int slot = interpreter_intern_category(interpreter, name);
+    if (slot >= 0) define_category_slot(interpreter, slot, statements, count, NULL);
 }
 
 Category* find_category(Interpreter* interpreter, const char* name) {
-    Category* current = interpreter->categories;
-    while (current != NULL) {
-        if (strcmp(current->name, name) == 0) return current;
-        current = current->next;
+    int slot = symbol_lookup(&interpreter->category_names, name);
+    if (slot < 0 || !interpreter->categories[slot].defined) return NULL;
+    return &interpreter->categories[slot];
+}
+
+void run_category_slot(Interpreter* interpreter, int slot) {
+    Category* category = &interpreter->categories[slot];
+    if (!category->defined) {
+        output_error(&interpreter->errors, "Runtime error: Undefined category '%s'\n", category->name);
+        return;
     }
-    return NULL;
+    // 本体の実行中に自身が再定義されても、実行中の本体は最後まで走らせる
+    ASTNode** statements = category->statements;
+    int count = category->statement_count;
+    if (interpreter->profile) profile_enter(interpreter->profile, slot);
+    for (int i = 0; i < count; i++)
+        interpret(interpreter, statements[i]);
+    if (interpreter->profile) profile_leave(interpreter->profile);
 }
 
 void run_category(Interpreter* interpreter, const char* name) {
-    Category* category = find_category(interpreter, name);
-    if (!category) {
-        fprintf(stderr, "Runtime error: Undefined category '%s'\n", name);
-        return;
+    int slot = interpreter_intern_category(interpreter, name);
+    if (slot >= 0) run_category_slot(interpreter, slot);
+}
+
+// 外部コードを実行して結果を result に入れる。Python の標準エラー出力と例外はエラーの出力先へ書く
+static int call_external(Interpreter* interpreter, const char* language, const char* code, PyWorkerResult* result) {
+    if (strcmp(language, "py") != 0) {
+        output_error(&interpreter->errors, "Runtime error: Unsupported external language '%s'\n", language);
+        return 0;
     }
-    for (int i = 0; i < category->statement_count; i++)
-        interpret(interpreter, category->statements[i]);
+    PyWorkerStatus status = pyworker_call(code, strlen(code), result);
+    if (status == PYWORKER_FAILED) {
+        output_error(&interpreter->errors, "Runtime error: call py failed: %s\n", result->errors);
+        pyworker_result_free(result);
+        return 0;
+    }
+    return status == PYWORKER_OK ? 1 : -1;
+}
+
+static void report_python_errors(Interpreter* interpreter, int status, PyWorkerResult* result) {
+    if (status < 0) output_error(&interpreter->errors, "Runtime error: call py raised an exception\n%s", result->errors);
+    else if (result->errors_length) output_write(&interpreter->errors, result->errors, result->errors_length);
+    pyworker_result_free(result);
 }
 
 void execute_external_code(Interpreter* interpreter, const char* language, const char* code) {
-    printf("External call: Language: %s, Code: %s\n", language, code);
-    if (strcmp(language, "py") == 0) {
-        printf("Executing Python code is not implemented in this C interpreter.\n");
-    } else {
-        fprintf(stderr, "Runtime error: Unsupported external language '%s'\n", language);
-    }
+    PyWorkerResult result;
+    int status = call_external(interpreter, language, code, &result);
+    if (!status) return;
+    output_write(&interpreter->output, result.output, result.output_length);
+    report_python_errors(interpreter, status, &result);
+}
+
+EvalResult evaluate_external_code(Interpreter* interpreter, const char* language, const char* code) {
+    PyWorkerResult result;
+    int status = call_external(interpreter, language, code, &result);
+    if (!status) return create_chars_result(interpreter->allocator, "", 0);
+    size_t length = result.output_length;
+    while (length > 0 && result.output[length - 1] == '\n') length--;
+    EvalResult value = create_chars_result(interpreter->allocator, result.output, length > INT_MAX ? INT_MAX : (int)length);
+    report_python_errors(interpreter, status, &result);
+    return value;
 }
 
 void interpret(Interpreter* interpreter, ASTNode* ast) {
     if (!ast) return;
+    if (ast->type != AST_COMPOUND_STATEMENT) {
+        STATS_INC(statements);
+        if (interpreter->profile)
+            profile_statement(interpreter->profile, profile_statement_id(interpreter->profile, ast->offset));
+    }
     switch (ast->type) {
         case AST_COMPOUND_STATEMENT:
             for (int i = 0; i < ast->data.compound_statement.statement_count; i++)
@@ -289,60 +638,47 @@ void interpret(Interpreter* interpreter, ASTNode* ast) {
         case AST_ASSIGNMENT: {
             EvalResult result = evaluate_expression(interpreter, ast->data.assignment.expression);
             int is_shared = 0;
-            set_variable(interpreter, ast->data.assignment.variable, result, is_shared);
-            if (result.type == RESULT_STRING) free(result.value.string);
+            set_variable_slot(interpreter, ast->data.assignment.slot, result, is_shared);
             break;
         }
         case AST_RE_ASSIGNMENT: {
             EvalResult result = evaluate_expression(interpreter, ast->data.assignment.expression);
-            Variable* var = get_variable(interpreter, ast->data.assignment.variable);
-            if (var) set_variable(interpreter, ast->data.assignment.variable, result, var->is_shared);
-            else fprintf(stderr, "Runtime error: Attempted 're' assignment to undeclared variable '%s'\n", ast->data.assignment.variable);
-            if (result.type == RESULT_STRING) free(result.value.string);
+            reassign_variable_slot(interpreter, ast->data.assignment.slot, result);
             break;
         }
         case AST_SUNUM_STATEMENT:
-            set_shared_variable(interpreter, ast->data.assignment.variable); break;
+            set_shared_variable_slot(interpreter, ast->data.assignment.slot); break;
         case AST_WRITE_STATEMENT: {
             EvalResult result = evaluate_expression(interpreter, ast->data.write_statement.expression);
-            if (result.type == RESULT_STRING) { printf("%s\n", result.value.string); free(result.value.string);}
-            else if (result.type == RESULT_NUMBER) printf("%g\n", result.value.number);
-            break;
-        }
-        case AST_NUM_WRITE_STATEMENT: {
-            Variable* var = get_variable(interpreter, ast->data.num_write_statement.variable_name);
-            if (var) {
-                if (var->type == VAR_NUMBER) printf("%g\n", var->value.number);
-                else if (var->type == VAR_STRING) printf("%s\n", var->value.string);
-            } else {
-                fprintf(stderr, "Runtime error: Undefined variable '%s' for 'num write'\n", ast->data.num_write_statement.variable_name);
-            }
+            write_result(interpreter, result);
+            release_result(result);
             break;
         }
+        case AST_NUM_WRITE_STATEMENT:
+            write_variable_slot(interpreter, ast->data.num_write_statement.slot); break;
         case AST_IF_STATEMENT: {
             EvalResult condition_result = evaluate_expression(interpreter, ast->data.if_statement.condition);
-            int is_true = 0;
-            if (condition_result.type == RESULT_NUMBER) is_true = (condition_result.value.number != 0);
-            else if (condition_result.type == RESULT_STRING) { is_true = (strlen(condition_result.value.string) > 0); free(condition_result.value.string);}
+            int is_true = result_is_truthy(condition_result);
+            release_result(condition_result);
             if (is_true) interpret(interpreter, ast->data.if_statement.then_stmt);
             else if (ast->data.if_statement.else_stmt != NULL)
                 interpret(interpreter, ast->data.if_statement.else_stmt);
             break;
         }
         case AST_CATEGORY_DEFINITION:
-             define_category(interpreter, ast->data.category_definition.name, ast->data.category_definition.statements, ast->data.category_definition.statement_count);
-             ast->data.category_definition.statements = NULL; 
+             define_category_slot(interpreter, ast->data.category_definition.slot, ast->data.category_definition.statements, ast->data.category_definition.statement_count, NULL);
              break;
         case AST_RUN_STATEMENT:
-            run_category(interpreter, ast->data.run_statement.category_name); break;
+            run_category_slot(interpreter, ast->data.run_statement.slot); break;
+        case AST_PARALLEL_RUN_STATEMENT:
+            parallel_run(interpreter, ast->data.parallel_run_statement.slots, ast->data.parallel_run_statement.count); break;
         case AST_CALL_STATEMENT:
             execute_external_code(interpreter, ast->data.call_statement.language, ast->data.call_statement.code); break;
         default:
-            if (ast->type >= AST_NUMBER && ast->type <= AST_UNARY_OP) {
-                EvalResult result = evaluate_expression(interpreter, ast);
-                if (result.type == RESULT_STRING) free(result.value.string);
+            if (ast->type >= AST_NUMBER && ast->type <= AST_CALL_EXPRESSION) {
+                release_result(evaluate_expression(interpreter, ast));
             } else {
-                fprintf(stderr, "Runtime error: Cannot interpret AST type %d\n", ast->type);
+                output_error(&interpreter->errors, "Runtime error: Cannot interpret AST type %d\n", ast->type);
             }
             break;
     }
@@ -1,58 +1,166 @@
 #ifndef INTERPRETER_H
 #define INTERPRETER_H
 
+#include <stdint.h>
+#include <string.h>
 #include "parser.h"
+#include "symbols.h"
+#include "rstring.h"
+#include "output.h"
+
+// インタプリタの版（コンパイル済みキャッシュの鍵に含まれる）
+#define STRINGS_VERSION "1.0"
+
+// この長さまでの文字列はヒープを使わず値の中に直接置く
+#define SHORT_STRING_MAX 15
 
 typedef struct Variable {
-    char* name;
+    const char* name;   // 記号表が所有する
     union {
         double number;
-        char* string;
+        RString* string;                            // VAR_STRING: 参照を1つ所有する
+        char short_string[SHORT_STRING_MAX + 1];    // VAR_SHORT_STRING: NUL終端
     } value;
-    enum { VAR_NUMBER, VAR_STRING } type;
+    enum { VAR_UNDEFINED, VAR_NUMBER, VAR_STRING, VAR_SHORT_STRING } type;
+    int short_length;
     int is_shared;
 } Variable;
 
+// スロット番号で引く変数表。未定義のスロットは VAR_UNDEFINED
 typedef struct {
     Variable* variables;
-    int count;
+    int count;      // 定義済みの変数の数
     int capacity;
 } VariableTable;
 
+struct Function;
+struct Profile;
+
+// カテゴリ表はカテゴリ名のスロット番号で直接引く。
+// run文は名前解決時にスロットへ束縛され、再定義はスロットの中身を差し替える
 typedef struct Category {
-    char* name;
-    ASTNode** statements;
+    const char* name;           // 記号表が所有する
+    int defined;
+    ASTNode** statements;       // ツリーウォーカー用。ASTのアリーナを参照する
     int statement_count;
-    struct Category* next;
+    struct Function* function;  // バイトコードVMで定義された場合の本体
+    struct Category* previous;  // 再定義前の本体（実行中の可能性があるので保持する）
 } Category;
 
-typedef struct {
+// 型推論の結果（変数スロットごと）
+typedef enum { TYPE_UNKNOWN, TYPE_NUMBER, TYPE_STRING, TYPE_DYNAMIC } ValueType;
+
+// 数値と証明された変数の未定義値。演算結果としては生じないシグナリングNaNのビット列で、
+// x87 を通すと壊れるので必ずメモリ上で比較・代入する
+#define UNDEFINED_NUMBER_BITS 0x7ff4dead0000beefULL
+
+typedef struct Interpreter {
+    Allocator* allocator;       // 変数表・カテゴリ表・実行時の文字列の割り当て先（prun では複数のスレッドから使う）
+    SymbolTable symbols;
     VariableTable variables;
     VariableTable shared_variables;
+    double* numbers;            // 数値と証明された変数の値（タグなし）。容量は variables と同じ
+    unsigned char* slot_types;  // ValueType。NULL なら型推論していない（すべて動的に扱う）
+    int slot_type_count;
+    SymbolTable category_names;
     Category* categories;
+    int category_capacity;
+    int category_definitions;   // これまでに実行したカテゴリ定義の数
+    int statement_markers;      // コンパイラが文ごとに OP_STMT を出力する（--stats / --profile）
+    struct Profile* profile;    // --profile 時のみ
+    struct Interpreter* parent; // prun のワーカーなら起動元の文脈（ローカル変数を読むだけ）
+    OutputSink output;          // write / num write / call の出力先
+    OutputSink errors;          // 実行時エラーの出力先
 } Interpreter;
 
 typedef struct {
     union {
         double number;
-        char* string;
+        RString* string;                            // RESULT_STRING: 参照を1つ所有する
+        char short_string[SHORT_STRING_MAX + 1];    // RESULT_SHORT_STRING: NUL終端
     } value;
-    enum { RESULT_NUMBER, RESULT_STRING } type;
+    enum { RESULT_NUMBER, RESULT_STRING, RESULT_SHORT_STRING } type;
+    int short_length;
 } EvalResult;
 
-Interpreter* interpreter_create();
+// 文字列の中身（type が RESULT_NUMBER でないこと）
+static inline const char* result_chars(const EvalResult* result) {
+    return result->type == RESULT_SHORT_STRING ? result->value.short_string : result->value.string->chars;
+}
+
+static inline int result_length(const EvalResult* result) {
+    return result->type == RESULT_SHORT_STRING ? result->short_length : result->value.string->length;
+}
+
+static inline int interpreter_slot_is_number(const Interpreter* interpreter, int slot) {
+    return slot < interpreter->slot_type_count && interpreter->slot_types[slot] == TYPE_NUMBER;
+}
+
+static inline int number_slot_defined(const double* value) {
+    uint64_t bits;
+    memcpy(&bits, value, sizeof(bits));
+    return bits != UNDEFINED_NUMBER_BITS;
+}
+
+// 出力先は既定でプロセスの標準出力と標準エラー。別々のスレッドで動かすインタプリタには
+// それぞれ専用の出力先を設定すること（インタプリタ同士で共有する大域状態は持たない）
+Interpreter* interpreter_create(Allocator* allocator);
 void interpreter_free(Interpreter* interpreter);
+// 再定義前のカテゴリ本体（previous）を解放する。どのカテゴリも実行中でないときだけ呼べる
+void interpreter_drop_category_history(Interpreter* interpreter);
+// prun のワーカーの文脈。記号表とカテゴリ表は parent の構造体を写し、同じ配列を読むだけにする
+// （ワーカーの interpreter_intern / interpreter_intern_category は既にある名前のスロットを返し、
+// 新しい名前は実行時エラーにして -1 を返す）。共有変数表は最上位のものを使う。
+// ローカル変数は空の表から始める（見つからなければ parent のものを読む）。数値スロットは写しを持つ。
+// 出力先は parent のものを引き継ぐ
+Interpreter* interpreter_create_worker(Interpreter* parent);
+void interpreter_free_worker(Interpreter* worker);
 void interpret(Interpreter* interpreter, ASTNode* ast);
 
+int interpreter_intern(Interpreter* interpreter, const char* name);
+int interpreter_intern_category(Interpreter* interpreter, const char* name);
+
+// 代入系は result の参照をそのまま変数へ移す（呼び出し側は解放しない）
 void set_variable(Interpreter* interpreter, const char* name, EvalResult result, int is_shared);
 Variable* get_variable(Interpreter* interpreter, const char* name);
 void set_shared_variable(Interpreter* interpreter, const char* name);
+void reassign_variable(Interpreter* interpreter, const char* name, EvalResult result);
+
+void set_variable_slot(Interpreter* interpreter, int slot, EvalResult result, int is_shared);
+Variable* get_variable_slot(Interpreter* interpreter, int slot);
+void set_shared_variable_slot(Interpreter* interpreter, int slot);
+void reassign_variable_slot(Interpreter* interpreter, int slot, EvalResult result);
+void set_number_slot(Interpreter* interpreter, int slot, double value);
+void reassign_number_slot(Interpreter* interpreter, int slot, double value);
 
+EvalResult create_number_result(double value);
+EvalResult create_string_result(RString* value);      // 参照を引き取る
+EvalResult create_chars_result(Allocator* allocator, const char* chars, int length);
+EvalResult create_cstring_result(Allocator* allocator, const char* value);
+EvalResult share_string_result(RString* value);       // 短ければコピー、長ければ参照を増やす
+EvalResult retain_result(EvalResult result);
+void release_result(EvalResult result);
 EvalResult evaluate_expression(Interpreter* interpreter, ASTNode* node);
+EvalResult evaluate_variable_slot(Interpreter* interpreter, int slot);
+
+// 演算子の意味論（ツリーウォーカーとVMで共有）。オペランドの所有権は消費される。
+// 新しい文字列は allocator から割り当て、実行時エラーは errors へ書く
+EvalResult apply_binary_op(Allocator* allocator, const OutputSink* errors, TokenType op, EvalResult left, EvalResult right);
+EvalResult apply_unary_op(const OutputSink* errors, TokenType op, EvalResult operand);
+EvalResult concat_string_result(Allocator* allocator, EvalResult left, const char* chars, int length);
+int string_results_equal(const EvalResult* left, const EvalResult* right);   // 両方とも文字列であること
+int result_is_truthy(EvalResult result);
+void write_result(Interpreter* interpreter, EvalResult result);
+void write_variable_slot(Interpreter* interpreter, int slot);
 
 void define_category(Interpreter* interpreter, const char* name, ASTNode** statements, int count);
+void define_category_slot(Interpreter* interpreter, int slot, ASTNode** statements, int count, struct Function* function);
+Category* find_category(Interpreter* interpreter, const char* name);
 void run_category(Interpreter* interpreter, const char* name);
+void run_category_slot(Interpreter* interpreter, int slot);
 
+// call py: 常駐ワーカーで実行する（pyworker.h）。文は出力をそのまま書き、式は出力の文字列（末尾の改行を除く）を返す
 void execute_external_code(Interpreter* interpreter, const char* language, const char* code);
+EvalResult evaluate_external_code(Interpreter* interpreter, const char* language, const char* code);
 
 #endif
\ No newline at end of file
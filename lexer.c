@@ -4,149 +4,153 @@
 #include <stdlib.h>
 #include <string.h>
 
-// strndupの代用
-static char* my_strndup(const char* s, size_t n) {
-    size_t len = 0;
-    while (len < n && s[len] != '\0') len++;
-    char* new_s = (char*)malloc(len + 1);
-    if (!new_s) return NULL;
-    memcpy(new_s, s, len);
-    new_s[len] = '\0';
-    return new_s;
+static Token create_token(TokenType type, int start, int length) {
+    return (Token){type, start, length};
 }
 
-static Token create_token(TokenType type, char* value, int line, int col) {
-    return (Token){type, value, line, col};
-}
-
-Lexer* lexer_create(const char* source) {
-    Lexer* lexer = malloc(sizeof(Lexer));
+// source はNUL終端でなくてよい（mmapしたファイルを直接読む）
+void lexer_init(Lexer* lexer, const char* source, int length) {
     lexer->source = source;
+    lexer->length = length;
     lexer->position = 0;
-    lexer->line = 1;
-    lexer->column = 1;
-    lexer->current_char = source[0];
+    lexer->current_char = length > 0 ? source[0] : '\0';
+    lexer->allocator = NULL;
+}
+
+Lexer* lexer_create(const char* source, int length, Allocator* allocator) {
+    Lexer* lexer = allocator_alloc(allocator, sizeof(Lexer), ALLOC_TOKENS);
+    lexer_init(lexer, source, length);
+    lexer->allocator = allocator;
     return lexer;
 }
 
 void lexer_free(Lexer* lexer) {
-    if (lexer) free(lexer);
+    if (lexer) allocator_free(lexer->allocator, lexer, sizeof(Lexer), ALLOC_TOKENS);
 }
 
-static void lexer_advance(Lexer* lexer) {
-    if (lexer->current_char == '\n') {
-        lexer->line++; lexer->column = 1;
-    } else {
-        lexer->column++;
+// 行・列は字句解析中には数えず、エラー表示で必要になったときにオフセットから求める
+void lexer_position(const char* source, int offset, int* line, int* column) {
+    int l = 1, c = 1;
+    for (int i = 0; i < offset; i++) {
+        if (source[i] == '\n') { l++; c = 1; }
+        else c++;
     }
+    *line = l;
+    *column = c;
+}
+
+static void lexer_advance(Lexer* lexer) {
     lexer->position++;
-    lexer->current_char = lexer->source[lexer->position];
+    lexer->current_char = lexer->position < lexer->length ? lexer->source[lexer->position] : '\0';
 }
 
 static void lexer_skip_whitespace(Lexer* lexer) {
-    while (lexer->current_char != '\0' && isspace(lexer->current_char)) lexer_advance(lexer);
+    while (lexer->current_char != '\0' && isspace((unsigned char)lexer->current_char)) lexer_advance(lexer);
+}
+
+// キーワード判定（長さで絞り込んでから比較する）
+static TokenType keyword_type(const char* text, int length) {
+    switch (length) {
+        case 2:
+            if (memcmp(text, "re", 2) == 0) return TOKEN_RE;
+            if (memcmp(text, "py", 2) == 0) return TOKEN_PY;
+            break;
+        case 3:
+            if (memcmp(text, "num", 3) == 0) return TOKEN_NUM;
+            if (memcmp(text, "run", 3) == 0) return TOKEN_RUN;
+            if (memcmp(text, "end", 3) == 0) return TOKEN_BLOCK_END;
+            break;
+        case 4:
+            if (memcmp(text, "call", 4) == 0) return TOKEN_CALL;
+            if (memcmp(text, "prun", 4) == 0) return TOKEN_PRUN;
+            if (memcmp(text, "func", 4) == 0) return TOKEN_FUNC;
+            break;
+        case 5:
+            if (memcmp(text, "write", 5) == 0) return TOKEN_WRITE;
+            if (memcmp(text, "sunum", 5) == 0) return TOKEN_SUNUM;
+            break;
+    }
+    return TOKEN_IDENTIFIER;
 }
 
 static Token lexer_read_identifier(Lexer* lexer) {
     int start = lexer->position;
-    int line = lexer->line;
-    int col = lexer->column;
-    while (lexer->current_char != '\0' && (isalnum(lexer->current_char) || lexer->current_char == '_')) {
+    while (lexer->current_char != '\0' && (isalnum((unsigned char)lexer->current_char) || lexer->current_char == '_')) {
         lexer_advance(lexer);
     }
     int len = lexer->position - start;
-    char* value = my_strndup(lexer->source + start, len);
-
-    // キーワード判定
-    if (strcmp(value, "write") == 0) return create_token(TOKEN_WRITE, value, line, col);
-    if (strcmp(value, "num") == 0) return create_token(TOKEN_NUM, value, line, col);
-    if (strcmp(value, "re") == 0) return create_token(TOKEN_RE, value, line, col);
-    if (strcmp(value, "sunum") == 0) return create_token(TOKEN_SUNUM, value, line, col);
-    if (strcmp(value, "run") == 0) return create_token(TOKEN_RUN, value, line, col);
-    if (strcmp(value, "call") == 0) return create_token(TOKEN_CALL, value, line, col);
-    if (strcmp(value, "py") == 0) return create_token(TOKEN_PY, value, line, col);
-    if (strcmp(value, "func") == 0) return create_token(TOKEN_FUNC, value, line, col);
-    if (strcmp(value, "end") == 0) return create_token(TOKEN_BLOCK_END, value, line, col);
-
-    return create_token(TOKEN_IDENTIFIER, value, line, col);
+    return create_token(keyword_type(lexer->source + start, len), start, len);
 }
 
+// 引用符の中身だけを指すトークンを返す
 static Token lexer_read_quoted(Lexer* lexer, char quote_type) {
-    int line = lexer->line;
-    int col = lexer->column;
+    int quote_start = lexer->position;
     lexer_advance(lexer); // skip start quote
     int start = lexer->position;
     while (lexer->current_char != '\0' && lexer->current_char != quote_type) {
         lexer_advance(lexer);
     }
     int len = lexer->position - start;
-    char* value = my_strndup(lexer->source + start, len);
 
     if (lexer->current_char == quote_type) {
         lexer_advance(lexer);
-        if (quote_type == '\'') return create_token(TOKEN_NUMBER, value, line, col);
-        else if (quote_type == '"') return create_token(TOKEN_STRING, value, line, col);
+        if (quote_type == '\'') return create_token(TOKEN_NUMBER, start, len);
+        else if (quote_type == '"') return create_token(TOKEN_STRING, start, len);
     }
-    free(value);
-    return create_token(TOKEN_ERROR, strdup("Unclosed quote"), line, col);
+    return create_token(TOKEN_ERROR, quote_start, lexer->position - quote_start); // Unclosed quote
 }
 
 Token lexer_next_token(Lexer* lexer) {
     lexer_skip_whitespace(lexer);
-    int line = lexer->line;
-    int col = lexer->column;
-    if (lexer->current_char == '\0') return create_token(TOKEN_EOF, NULL, line, col);
+    int start = lexer->position;
+    if (lexer->current_char == '\0') return create_token(TOKEN_EOF, start, 0);
 
-    if (isalpha(lexer->current_char) || lexer->current_char == '_') return lexer_read_identifier(lexer);
+    if (isalpha((unsigned char)lexer->current_char) || lexer->current_char == '_') return lexer_read_identifier(lexer);
     if (lexer->current_char == '\'' || lexer->current_char == '"') return lexer_read_quoted(lexer, lexer->current_char);
 
     // コメント
     if (lexer->current_char == '#') {
         lexer_advance(lexer);
-        int start = lexer->position;
         while (lexer->current_char != '\0' && lexer->current_char != '\n') lexer_advance(lexer);
-        int len = lexer->position - start;
-        char* value = my_strndup(lexer->source + start, len);
-        return create_token(TOKEN_COMMENT, value, line, col);
+        return create_token(TOKEN_COMMENT, start + 1, lexer->position - start - 1);
     }
 
     char current_char = lexer->current_char;
     lexer_advance(lexer);
     switch (current_char) {
-        case '+': if (lexer->current_char == '*') { lexer_advance(lexer); return create_token(TOKEN_MULTIPLY, strdup("+*"), line, col);} return create_token(TOKEN_PLUS, strdup("+"), line, col);
-        case '-': if (lexer->current_char == '*') { lexer_advance(lexer); return create_token(TOKEN_DIVIDE, strdup("-*"), line, col);} return create_token(TOKEN_MINUS, strdup("-"), line, col);
-        case '=': if (lexer->current_char == '=') { lexer_advance(lexer); return create_token(TOKEN_EQ, strdup("=="), line, col);} return create_token(TOKEN_ASSIGN, strdup("="), line, col);
-        case '!': if (lexer->current_char == '=') { lexer_advance(lexer); return create_token(TOKEN_NEQ, strdup("!="), line, col);} return create_token(TOKEN_ELSE, strdup("!"), line, col);
-        case '>': if (lexer->current_char == '=') { lexer_advance(lexer); return create_token(TOKEN_GTE, strdup(">="), line, col);} return create_token(TOKEN_GT, strdup(">"), line, col);
-        case '<': if (lexer->current_char == '=') { lexer_advance(lexer); return create_token(TOKEN_LTE, strdup("<="), line, col);} return create_token(TOKEN_LT, strdup("<"), line, col);
-        case '%': return create_token(TOKEN_MOD, strdup("%"), line, col);
-        case '&': return create_token(TOKEN_AMPERSAND, strdup("&"), line, col);
-        case '|': return create_token(TOKEN_PIPE, strdup("|"), line, col);
-        case '~': return create_token(TOKEN_TILDE, strdup("~"), line, col);
-        case '?': return create_token(TOKEN_IF, strdup("?"), line, col);
-        case '(': return create_token(TOKEN_LPAREN, strdup("("), line, col);
-        case ')': return create_token(TOKEN_RPAREN, strdup(")"), line, col);
-        case ';': return create_token(TOKEN_MULTI_CMD, strdup(";"), line, col);
-        case '/': return create_token(TOKEN_CMD_END, strdup("/"), line, col);
-        case '@': return create_token(TOKEN_AT, strdup("@"), line, col);
-        case '\\': return create_token(TOKEN_BACKSLASH, strdup("\\"), line, col);
+        case '+': if (lexer->current_char == '*') { lexer_advance(lexer); return create_token(TOKEN_MULTIPLY, start, 2);} return create_token(TOKEN_PLUS, start, 1);
+        case '-': if (lexer->current_char == '*') { lexer_advance(lexer); return create_token(TOKEN_DIVIDE, start, 2);} return create_token(TOKEN_MINUS, start, 1);
+        case '=': if (lexer->current_char == '=') { lexer_advance(lexer); return create_token(TOKEN_EQ, start, 2);} return create_token(TOKEN_ASSIGN, start, 1);
+        case '!': if (lexer->current_char == '=') { lexer_advance(lexer); return create_token(TOKEN_NEQ, start, 2);} return create_token(TOKEN_ELSE, start, 1);
+        case '>': if (lexer->current_char == '=') { lexer_advance(lexer); return create_token(TOKEN_GTE, start, 2);} return create_token(TOKEN_GT, start, 1);
+        case '<': if (lexer->current_char == '=') { lexer_advance(lexer); return create_token(TOKEN_LTE, start, 2);} return create_token(TOKEN_LT, start, 1);
+        case '%': return create_token(TOKEN_MOD, start, 1);
+        case '&': return create_token(TOKEN_AMPERSAND, start, 1);
+        case '|': return create_token(TOKEN_PIPE, start, 1);
+        case '~': return create_token(TOKEN_TILDE, start, 1);
+        case '?': return create_token(TOKEN_IF, start, 1);
+        case '(': return create_token(TOKEN_LPAREN, start, 1);
+        case ')': return create_token(TOKEN_RPAREN, start, 1);
+        case ';': return create_token(TOKEN_MULTI_CMD, start, 1);
+        case '/': return create_token(TOKEN_CMD_END, start, 1);
+        case '@': return create_token(TOKEN_AT, start, 1);
+        case '\\': return create_token(TOKEN_BACKSLASH, start, 1);
     }
-    char unknown[2] = {current_char, '\0'};
-    return create_token(TOKEN_ERROR, strdup(unknown), line, col);
+    return create_token(TOKEN_ERROR, start, 1);
 }
 
-TokenList tokenize(const char* source) {
-    Lexer* lexer = lexer_create(source);
+// トークン列をまとめて作る（パーサは使わない。ツールやベンチマーク用）
+TokenList tokenize(const char* source, int length, Arena* arena) {
+    Lexer* lexer = lexer_create(source, length, arena->allocator);
     TokenList tokens;
     tokens.count = 0;
-    tokens.capacity = 10;
-    tokens.tokens = malloc(sizeof(Token) * tokens.capacity);
+    tokens.capacity = 64;
+    tokens.tokens = arena_alloc(arena, sizeof(Token) * tokens.capacity);
     while (1) {
         Token token = lexer_next_token(lexer);
         if (tokens.count >= tokens.capacity) {
+            tokens.tokens = arena_grow(arena, tokens.tokens, sizeof(Token) * tokens.capacity, sizeof(Token) * tokens.capacity * 2);
             tokens.capacity *= 2;
-            tokens.tokens = realloc(tokens.tokens, sizeof(Token) * tokens.capacity);
-            if (!tokens.tokens) { fprintf(stderr, "Fatal error: Failed to reallocate tokens.\n"); exit(1);}
         }
         tokens.tokens[tokens.count++] = token;
         if (token.type == TOKEN_EOF || token.type == TOKEN_ERROR) break;
@@ -155,17 +159,6 @@ TokenList tokenize(const char* source) {
     return tokens;
 }
 
-void free_tokens(TokenList* tokens) {
-    if (!tokens) return;
-    for (int i = 0; i < tokens->count; i++) {
-        if (tokens->tokens[i].value) free(tokens->tokens[i].value);
-    }
-    free(tokens->tokens);
-    tokens->tokens = NULL;
-    tokens->count = 0;
-    tokens->capacity = 0;
-}
-
 const char* token_to_string(TokenType type) {
     switch (type) {
         case TOKEN_PLUS: return "'+'";
@@ -197,6 +190,7 @@ const char* token_to_string(TokenType type) {
         case TOKEN_RE: return "RE";
         case TOKEN_SUNUM: return "SUNUM";
         case TOKEN_RUN: return "RUN";
+        case TOKEN_PRUN: return "PRUN";
         case TOKEN_CALL: return "CALL";
         case TOKEN_PY: return "PY";
         case TOKEN_FUNC: return "FUNC";
@@ -1,6 +1,8 @@
 #ifndef LEXER_H
 #define LEXER_H
 
+#include "arena.h"
+
 // トークン（コードの部品）の種類
 typedef enum {
     // 記号・演算子
@@ -14,25 +16,26 @@ typedef enum {
     TOKEN_ASSIGN,    // =
     TOKEN_AT,        // @
     TOKEN_YEN,       // YEN (未使用可)
-    TOKEN_BACKSLASH, // \
+    TOKEN_BACKSLASH, // '\'
 
     // データ型
     TOKEN_IDENTIFIER, TOKEN_STRING, TOKEN_NUMBER,
 
     // キーワード
     TOKEN_WRITE, TOKEN_NUM, TOKEN_RE, TOKEN_SUNUM,
-    TOKEN_RUN, TOKEN_CALL, TOKEN_PY, TOKEN_FUNC, TOKEN_BLOCK_END,
+    TOKEN_RUN, TOKEN_PRUN, TOKEN_CALL, TOKEN_PY, TOKEN_FUNC, TOKEN_BLOCK_END,
 
     // その他
     TOKEN_COMMENT, TOKEN_ERROR, TOKEN_EOF
 } TokenType;
 
 // トークン構造体
+// トークンはソースバッファへのスライス（オフセットと長さ）。
+// 文字列・数値リテラルは引用符の内側を、コメントは '#' の後ろを指す
 typedef struct {
     TokenType type;
-    char* value;
-    int line;
-    int column;
+    int start;
+    int length;
 } Token;
 
 typedef struct {
@@ -43,18 +46,19 @@ typedef struct {
 
 typedef struct {
     const char* source;
+    int length;
     int position;
-    int line;
-    int column;
     char current_char;
+    Allocator* allocator;   // lexer_create で割り当てたときのみ
 } Lexer;
 
 // 関数宣言
-Lexer* lexer_create(const char* source);
+void lexer_init(Lexer* lexer, const char* source, int length);
+Lexer* lexer_create(const char* source, int length, Allocator* allocator);
 void lexer_free(Lexer* lexer);
 Token lexer_next_token(Lexer* lexer);
-TokenList tokenize(const char* source);
-void free_tokens(TokenList* tokens);
+TokenList tokenize(const char* source, int length, Arena* arena);
+void lexer_position(const char* source, int offset, int* line, int* column);
 const char* token_to_string(TokenType type);
 
 #endif
\ No newline at end of file
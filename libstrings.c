@@ -0,0 +1,222 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include "libstrings.h"
+#include "parser.h"
+#include "interpreter.h"
+#include "resolver.h"
+#include "optimizer.h"
+#include "inference.h"
+#include "compiler.h"
+#include "vm.h"
+
+// コンパイル済みのプログラム。実行中に書き換わるのは命令の型特化だけ（VM がアトミックに行う）なので、
+// 複数のコンテキストから同時に実行できる
+struct StringsProgram {
+    Program* program;
+    Interpreter* names;         // 記号表・カテゴリ名・型推論の結果。コンテキストはこれを写して作る（実行はしない）
+    unsigned char* inputs;      // スロットごとに入力変数なら 1
+};
+
+// 出力とエラーを溜めるバッファ（常に NUL終端）
+typedef struct {
+    char* data;
+    size_t length;
+    size_t capacity;
+} TextBuffer;
+
+struct StringsContext {
+    const StringsProgram* program;
+    Interpreter* interpreter;
+    VM* vm;
+    TextBuffer output;
+    TextBuffer errors;
+    int error_count;
+};
+
+static void text_write(void* context, const char* data, size_t length) {
+    TextBuffer* buffer = context;
+    if (buffer->length + length + 1 > buffer->capacity) {
+        size_t capacity = buffer->capacity ? buffer->capacity * 2 : 256;
+        while (capacity < buffer->length + length + 1) capacity *= 2;
+        char* grown = realloc(buffer->data, capacity);
+        if (!grown) { perror("realloc failed"); exit(EXIT_FAILURE); }
+        buffer->data = grown;
+        buffer->capacity = capacity;
+    }
+    memcpy(buffer->data + buffer->length, data, length);
+    buffer->length += length;
+    buffer->data[buffer->length] = '\0';
+}
+
+static void text_clear(TextBuffer* buffer) {
+    buffer->length = 0;
+    if (buffer->data) buffer->data[0] = '\0';
+}
+
+static const char* text_chars(const TextBuffer* buffer, size_t* length) {
+    if (length) *length = buffer->length;
+    return buffer->data ? buffer->data : "";
+}
+
+// エラーの出力先。件数を数えてから溜める
+static void context_error(void* context, const char* data, size_t length) {
+    StringsContext* strings = context;
+    strings->error_count++;
+    text_write(&strings->errors, data, length);
+}
+
+// --- Program ---
+StringsProgram* strings_compile(const char* source, size_t length,
+                                const char* const* inputs, int input_count, char** errors) {
+    if (errors) *errors = NULL;
+    TextBuffer messages = { NULL, 0, 0 };
+    OutputSink sink = { text_write, &messages };
+    if (length > INT_MAX) {
+        output_error(&sink, "Error: source is too large\n");
+        if (errors) *errors = messages.data;
+        else free(messages.data);
+        return NULL;
+    }
+
+    Arena arena;
+    arena_init(&arena, allocator_default(), ALLOC_AST);
+    Parser* parser = parser_create(source, (int)length, &arena, allocator_default());
+    parser->errors = sink;
+    ASTNode* ast = parse(parser);
+    // 空のソース（コメントだけのものを含む）は何もしないプログラムにする
+    int empty = !ast && messages.length == 0 && parser->current_token.type == TOKEN_EOF;
+    parser_free(parser);
+    Interpreter* names = interpreter_create(allocator_default());
+    names->output = sink;
+    names->errors = sink;
+    Program* program = NULL;
+    if (ast || empty) {
+        int* input_slots = malloc(sizeof(int) * (size_t)(input_count > 0 ? input_count : 1));
+        if (!input_slots) { perror("malloc failed"); exit(EXIT_FAILURE); }
+        for (int i = 0; i < input_count; i++) input_slots[i] = interpreter_intern(names, inputs[i]);
+        ast = optimize(ast, &arena);
+        if (ast) resolve_names(names, ast);
+        infer_types_with_inputs(names, ast, input_slots, input_count, NULL);
+        program = compile(ast, names);
+        free(input_slots);
+    }
+    // プログラムは定数と関数を自分で持つので、AST はもう要らない
+    arena_free(&arena);
+    // sink はこの関数のローカルな messages を指すので、保存する names には残さない
+    names->output = output_stdout_sink();
+    names->errors = output_stderr_sink();
+    if (!program) {
+        interpreter_free(names);
+        if (errors) *errors = messages.data;
+        else free(messages.data);
+        return NULL;
+    }
+    free(messages.data);
+
+    StringsProgram* compiled = malloc(sizeof(StringsProgram));
+    unsigned char* input_flags = calloc((size_t)names->symbols.count + 1, 1);
+    if (!compiled || !input_flags) { perror("malloc failed"); exit(EXIT_FAILURE); }
+    for (int i = 0; i < input_count; i++) input_flags[symbol_lookup(&names->symbols, inputs[i])] = 1;
+    compiled->program = program;
+    compiled->names = names;
+    compiled->inputs = input_flags;
+    return compiled;
+}
+
+void strings_program_free(StringsProgram* program) {
+    if (!program) return;
+    program_free(program->program);
+    interpreter_free(program->names);
+    free(program->inputs);
+    free(program);
+}
+
+// --- Context ---
+// プログラムと同じスロット番号になるよう、名前を同じ順に登録する
+StringsContext* strings_context_create(const StringsProgram* program) {
+    StringsContext* context = calloc(1, sizeof(StringsContext));
+    if (!context) { perror("malloc failed"); exit(EXIT_FAILURE); }
+    const Interpreter* names = program->names;
+    Interpreter* interpreter = interpreter_create(allocator_default());
+    for (int i = 0; i < names->symbols.count; i++) interpreter_intern(interpreter, names->symbols.names[i]);
+    for (int i = 0; i < names->category_names.count; i++) interpreter_intern_category(interpreter, names->category_names.names[i]);
+    if (names->slot_types) {
+        interpreter->slot_types = allocator_calloc(interpreter->allocator, (size_t)names->slot_type_count + 1, 1, ALLOC_VARIABLES);
+        memcpy(interpreter->slot_types, names->slot_types, (size_t)names->slot_type_count);
+        interpreter->slot_type_count = names->slot_type_count;
+    }
+    interpreter->output.write = text_write;
+    interpreter->output.context = &context->output;
+    interpreter->errors.write = context_error;
+    interpreter->errors.context = context;
+    context->program = program;
+    context->interpreter = interpreter;
+    context->vm = vm_create(interpreter);
+    return context;
+}
+
+void strings_context_free(StringsContext* context) {
+    if (!context) return;
+    vm_free(context->vm);
+    interpreter_free(context->interpreter);
+    free(context->output.data);
+    free(context->errors.data);
+    free(context);
+}
+
+static int input_slot(StringsContext* context, const char* name) {
+    int slot = symbol_lookup(&context->interpreter->symbols, name);
+    return slot >= 0 && context->program->inputs[slot] ? slot : -1;
+}
+
+int strings_set_number(StringsContext* context, const char* name, double value) {
+    int slot = input_slot(context, name);
+    if (slot < 0) return 0;
+    set_variable_slot(context->interpreter, slot, create_number_result(value), 0);
+    return 1;
+}
+
+int strings_set_string(StringsContext* context, const char* name, const char* value, size_t length) {
+    int slot = input_slot(context, name);
+    if (slot < 0 || length > INT_MAX) return 0;
+    set_variable_slot(context->interpreter, slot, create_chars_result(context->interpreter->allocator, value, (int)length), 0);
+    return 1;
+}
+
+int strings_run(StringsContext* context) {
+    text_clear(&context->output);
+    text_clear(&context->errors);
+    context->error_count = 0;
+    // 前の実行は終わっているので、再定義で積んだ古い本体は要らない
+    interpreter_drop_category_history(context->interpreter);
+    vm_run(context->vm, context->program->program);
+    return context->error_count == 0;
+}
+
+int strings_get_number(StringsContext* context, const char* name, double* value) {
+    Variable* var = get_variable(context->interpreter, name);
+    if (!var || var->type != VAR_NUMBER) return 0;
+    if (value) *value = var->value.number;
+    return 1;
+}
+
+const char* strings_get_string(StringsContext* context, const char* name, size_t* length) {
+    Variable* var = get_variable(context->interpreter, name);
+    if (!var || (var->type != VAR_STRING && var->type != VAR_SHORT_STRING)) return NULL;
+    if (var->type == VAR_SHORT_STRING) {
+        if (length) *length = (size_t)var->short_length;
+        return var->value.short_string;
+    }
+    if (length) *length = (size_t)var->value.string->length;
+    return var->value.string->chars;
+}
+
+const char* strings_output(const StringsContext* context, size_t* length) {
+    return text_chars(&context->output, length);
+}
+
+const char* strings_errors(const StringsContext* context, size_t* length) {
+    return text_chars(&context->errors, length);
+}
@@ -0,0 +1,55 @@
+#ifndef LIBSTRINGS_H
+#define LIBSTRINGS_H
+
+// Strings 言語の埋め込み用 API（libstrings.a / libstrings.so）。
+// ソースは一度だけコンパイルし、できたプログラムを何度でも、複数のスレッドから同時に実行できる。
+// 実行はコンテキストごとに行い、コンテキストは変数・出力・エラーをそれぞれ専用に持つ（1つのスレッドで使うこと）
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if defined(__GNUC__)
+#define STRINGS_API __attribute__((visibility("default")))
+#else
+#define STRINGS_API
+#endif
+
+typedef struct StringsProgram StringsProgram;
+typedef struct StringsContext StringsContext;
+
+// source をコンパイルする。inputs は実行前にホストが値を入れる変数の名前（型推論で数値に決め打ちしない）。
+// 空のソース（コメントだけのものを含む）は何もしないプログラムになる。
+// 失敗したら NULL を返し、errors が NULL でなければ構文・コンパイルエラーのメッセージ（free() で解放）を入れる
+STRINGS_API StringsProgram* strings_compile(const char* source, size_t length,
+                                            const char* const* inputs, int input_count, char** errors);
+// このプログラムのコンテキストをすべて解放してから呼ぶこと
+STRINGS_API void strings_program_free(StringsProgram* program);
+
+STRINGS_API StringsContext* strings_context_create(const StringsProgram* program);
+STRINGS_API void strings_context_free(StringsContext* context);
+
+// 入力変数に値を入れる。strings_compile の inputs にない名前なら 0 を返す
+STRINGS_API int strings_set_number(StringsContext* context, const char* name, double value);
+STRINGS_API int strings_set_string(StringsContext* context, const char* name, const char* value, size_t length);
+
+// プログラムを実行する。変数は前の実行のものを引き継ぎ、出力とエラーは実行ごとに空にしてから溜める。
+// 実行時エラーを出したら 0 を返す
+STRINGS_API int strings_run(StringsContext* context);
+
+// 変数を読む。strings_get_number は数値で定義済みなら 1 を返す。
+// strings_get_string は文字列でなければ NULL を返す（次の実行・代入・解放まで有効）
+STRINGS_API int strings_get_number(StringsContext* context, const char* name, double* value);
+STRINGS_API const char* strings_get_string(StringsContext* context, const char* name, size_t* length);
+
+// 直前の実行の write / num write / call の出力と、実行時エラーのメッセージ（NUL終端。次の実行・解放まで有効）
+STRINGS_API const char* strings_output(const StringsContext* context, size_t* length);
+STRINGS_API const char* strings_errors(const StringsContext* context, size_t* length);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -4,13 +4,125 @@
 #include "lexer.h"
 #include "parser.h"
 #include "interpreter.h"
+#include "compiler.h"
+#include "vm.h"
+#include "resolver.h"
+#include "optimizer.h"
+#include "inference.h"
+#include "source.h"
+#include "output.h"
+#include "stats.h"
+#include "profile.h"
+#include "cache.h"
+#include "batch.h"
+#include "pyworker.h"
+
+// --tree-walk 指定時は従来のASTウォーカーで実行する（VMとの出力比較用）
+static int use_tree_walker = 0;
+// --arena-stats 指定時はフェーズごとのアリーナ使用量を表示する
+static int show_arena_stats = 0;
+// --dump-ast 指定時は最適化後のASTを表示するだけで実行しない
+static int dump_ast = 0;
+// --explain-types 指定時は型推論の結果を表示する
+static int explain_types = 0;
+// --stats 指定時はフェーズごとの時間と実行時のカウンタを表示する
+static int show_stats = 0;
+// --profile FILE 指定時は文ごとの実行回数と時間を表示し、カテゴリの呼び出し文脈ごとの時間を FILE へ書く
+static const char* profile_path = NULL;
+// --cache-dir DIR（または環境変数 STRINGS_CACHE_DIR）指定時はコンパイル結果を DIR に保存し、次回は構文解析を省く
+static const char* cache_dir = NULL;
+// --batch PATH 指定時はディレクトリ（またはリスト）のスクリプトを --jobs 個のスレッドで実行する
+static const char* batch_path = NULL;
+static int batch_jobs = 0;
+// --py-workers N 指定時は call py の常駐 Python プロセスを最大 N 個にする
+static int py_workers = 0;
+
+// --- Stats ---
+typedef enum { PHASE_READ, PHASE_LEX, PHASE_PARSE, PHASE_EXECUTE, PHASE_COUNT } Phase;
+static const char* phase_names[PHASE_COUNT] = { "read", "lex", "parse", "execute" };
+static StatsTime phase_totals[PHASE_COUNT];
+static long long token_count = 0;
+static const char* cache_status = "off";
+
+static void phase_end(Phase phase, StatsTime start) {
+    StatsTime end = stats_now();
+    phase_totals[phase].wall += end.wall - start.wall;
+    phase_totals[phase].cpu += end.cpu - start.cpu;
+}
+
+// パーサはトークンを必要な分だけ引き出すので、字句解析だけの時間は別に1回走らせて測る
+static void measure_lexing(const char* source, int length) {
+    StatsTime start = stats_now();
+    Lexer lexer;
+    lexer_init(&lexer, source, length);
+    while (1) {
+        TokenType type = lexer_next_token(&lexer).type;
+        token_count++;
+        if (type == TOKEN_EOF || type == TOKEN_ERROR) break;
+    }
+    phase_end(PHASE_LEX, start);
+}
+
+#ifdef STRINGS_STATS
+static const char* ast_type_names[AST_NODE_TYPE_COUNT] = {
+    "Number", "String", "Identifier", "BinaryOp", "UnaryOp", "CallValue", "Assignment", "ReAssignment",
+    "Sunum", "If", "Compound", "FunctionCall", "Write", "NumWrite", "Run", "Call", "Category",
+    "ParallelRun"
+};
+#endif
+
+static void report_stats(const Interpreter* interpreter) {
+    output_flush();
+    fprintf(stderr, "Stats:\n");
+    fprintf(stderr, "  %-10s %12s %12s\n", "phase", "wall ms", "cpu ms");
+    for (int i = 0; i < PHASE_COUNT; i++)
+        fprintf(stderr, "  %-10s %12.3f %12.3f\n", phase_names[i], phase_totals[i].wall * 1e3, phase_totals[i].cpu * 1e3);
+    double lex_seconds = phase_totals[PHASE_LEX].wall;
+    fprintf(stderr, "  cache      %s\n", cache_status);
+    fprintf(stderr, "  tokens     %lld (%.0f tokens/sec)\n", token_count, lex_seconds > 0 ? token_count / lex_seconds : 0.0);
+    int categories = 0;
+    for (int i = 0; i < interpreter->category_capacity; i++)
+        if (interpreter->categories[i].defined) categories++;
+    fprintf(stderr, "  variables  %d defined, %d names, table capacity %d, %d shared\n",
+            interpreter->variables.count, interpreter->symbols.count, interpreter->variables.capacity,
+            interpreter->shared_variables.count);
+    fprintf(stderr, "  categories %d defined, %d names\n", categories, interpreter->category_names.count);
+    allocator_report(interpreter->allocator, stderr);
+#ifdef STRINGS_STATS
+    long long nodes = 0;
+    for (int i = 0; i < AST_NODE_TYPE_COUNT; i++) nodes += stats.ast_nodes[i];
+    fprintf(stderr, "  AST nodes  %lld\n", nodes);
+    for (int i = 0; i < AST_NODE_TYPE_COUNT; i++)
+        if (stats.ast_nodes[i]) fprintf(stderr, "    %-14s %lld\n", ast_type_names[i], stats.ast_nodes[i]);
+    fprintf(stderr, "  statements %lld executed\n", stats.statements);
+    // アロケータを通らない割り当て（出力バッファや libc 内部など）も含めたプロセス全体の数
+    if (stats_counts_allocations())
+        fprintf(stderr, "  malloc     %lld allocations, %lld frees, peak %lld bytes\n", stats.mallocs, stats.frees, stats.peak_bytes);
+#else
+    fprintf(stderr, "  (node, statement and allocation counts need a build with STRINGS_STATS)\n");
+#endif
+}
 
 void print_help() {
     printf("Custom Language Interpreter\n");
     printf("Usage:\n");
     printf("  ./interpreter <filename>  - Execute a script file (Use interpreter instead of strings.exe)\n");
+    printf("  ./interpreter -           - Execute a script read from standard input\n");
     printf("  ./interpreter -i          - Start interactive mode (REPL)\n");
-    printf("  ./interpreter -h          - Show this help message\n\n");
+    printf("  ./interpreter -h          - Show this help message\n");
+    printf("Options:\n");
+    printf("  --tree-walk               - Execute with the AST tree walker instead of the bytecode VM\n");
+    printf("  --arena-stats             - Report arena bytes used by parsing\n");
+    printf("  --dump-ast                - Print the optimized AST instead of executing\n");
+    printf("  --explain-types           - Report which variables type inference proved numeric or string\n");
+    printf("  --output FILE             - Write script output to FILE instead of standard output\n");
+    printf("  --stats                   - Report per-phase timings, counts and allocation totals\n");
+    printf("  --profile FILE            - Report time per statement and write folded category stacks to FILE\n");
+    printf("  --cache-dir DIR           - Cache compiled scripts in DIR (default: $STRINGS_CACHE_DIR)\n");
+    printf("  --batch DIR|LIST          - Run every *.str in DIR (or each path listed in LIST), writing <name>.out files\n");
+    printf("  --jobs N                  - Worker threads for --batch (default: $STRINGS_THREADS or CPU count)\n");
+    printf("                              With --batch, --output DIR collects the .out files in DIR\n");
+    printf("  --py-workers N            - Python processes kept for call py (default: $STRINGS_PY_WORKERS or CPU count)\n\n");
     printf("Language Syntax Example:\n");
     printf("  # This is a comment\n");
     printf("  my_var = '10' / \n");
@@ -20,69 +132,222 @@ void print_help() {
     printf("  x > '5' ? write \"YES\" ; ! write \"NO\" / \n");
 }
 
+// 実行セッション。カテゴリ本体から参照され続けるプログラムとASTを保持する
+typedef struct {
+    Interpreter* interpreter;
+    VM* vm;
+    Program** programs;
+    int program_count;
+    Arena* arenas;
+    int arena_count;
+    int whole_script;   // 1つのスクリプトだけを実行する（型推論できる）
+    const CacheEntry* cache;    // コンパイルしたらここへ保存する（NULL なら保存しない）
+} Session;
+
+static void session_init(Session* session) {
+    session->interpreter = interpreter_create(allocator_default());
+    session->interpreter->statement_markers = show_stats || profile_path;
+    session->vm = vm_create(session->interpreter);
+    session->programs = NULL;
+    session->program_count = 0;
+    session->arenas = NULL;
+    session->arena_count = 0;
+    session->whole_script = 0;
+    session->cache = NULL;
+}
+
+static void session_free(Session* session) {
+    for (int i = 0; i < session->program_count; i++) program_free(session->programs[i]);
+    free(session->programs);
+    for (int i = 0; i < session->arena_count; i++) arena_free(&session->arenas[i]);
+    free(session->arenas);
+    vm_free(session->vm);
+    interpreter_free(session->interpreter);
+}
+
+static void report_arena(const char* phase, size_t bytes) {
+    if (show_arena_stats) fprintf(stderr, "Arena: %-6s %zu bytes\n", phase, bytes);
+}
+
+static void report_profile(const Interpreter* interpreter, const char* source, size_t length) {
+    output_flush();
+    FILE* folded = fopen(profile_path, "w");
+    if (!folded) perror("Error opening profile file");
+    profile_report(interpreter->profile, source, length, &interpreter->category_names, stderr, folded);
+    if (folded) fclose(folded);
+}
+
+// カテゴリ本体がプログラム内の関数を参照するので、その場合はセッションへ移す
+static void run_program(Session* session, Program* program) {
+    if (session->interpreter->profile) profile_start(session->interpreter->profile);
+    vm_run(session->vm, program);
+    if (program->function_count > 1) {
+        session->programs = realloc(session->programs, sizeof(Program*) * (session->program_count + 1));
+        session->programs[session->program_count++] = program;
+    } else {
+        program_free(program);
+    }
+}
+
+// 最適化・名前解決・型推論を済ませてから実行する
+static int execute_ast(Session* session, ASTNode* ast, Arena* arena) {
+    ast = optimize(ast, arena);
+    if (dump_ast) {
+        ast_dump(stdout, ast, 0);
+        return 1;
+    }
+    if (!ast) return 1;
+
+    Interpreter* interpreter = session->interpreter;
+    resolve_names(interpreter, ast);
+    // REPL は後から入力される行で型が変わりうるので推論しない
+    if (session->whole_script) infer_types(interpreter, ast, explain_types ? stderr : NULL);
+    if (use_tree_walker) {
+        int definitions = interpreter->category_definitions;
+        if (interpreter->profile) profile_start(interpreter->profile);
+        interpret(interpreter, ast);
+        // カテゴリ本体がこのASTを参照しているので、アリーナごとセッションへ移す
+        if (interpreter->category_definitions != definitions) {
+            session->arenas = realloc(session->arenas, sizeof(Arena) * (session->arena_count + 1));
+            session->arenas[session->arena_count++] = *arena;
+            arena_init(arena, arena->allocator, arena->tag);
+        }
+        return 1;
+    }
+    Program* program = compile(ast, interpreter);
+    if (!program) return 1;
+    // 実行すると型特化命令に書き換わるので、その前に保存する
+    if (session->cache) cache_store(session->cache, program, interpreter);
+    run_program(session, program);
+    return 1;
+}
+
+// ソースを構文解析して実行する。AST はすべて arena 上に作られる
+static int execute_source(Session* session, const char* source, int length, Arena* arena) {
+    if (show_stats) measure_lexing(source, length);
+    // 字句解析はパーサが必要な分だけ進めるので、アリーナを使うのは構文解析だけ
+    StatsTime start = stats_now();
+    Parser* parser = parser_create(source, length, arena, session->interpreter->allocator);
+    ASTNode* ast = parse(parser);
+    parser_free(parser);
+    phase_end(PHASE_PARSE, start);
+    report_arena("parse", arena->bytes_used);
+    if (!ast) return 0;
+    start = stats_now();
+    int ok = execute_ast(session, ast, arena);
+    phase_end(PHASE_EXECUTE, start);
+    return ok;
+}
+
 void interactive_mode() {
     char input[2048];
     printf("Interactive Mode. Type 'exit/' to quit.\n");
-    Interpreter* interpreter = interpreter_create();
+    Session session;
+    session_init(&session);
+    Arena arena;
+    arena_init(&arena, allocator_default(), ALLOC_AST);
     while (1) {
         printf("> ");
         if (!fgets(input, sizeof(input), stdin)) break;
         input[strcspn(input, "\n")] = 0;
         if (strcmp(input, "exit/") == 0) break;
         if (strlen(input) == 0) continue;
-        TokenList tokens = tokenize(input);
-        Parser* parser = parser_create(tokens);
-        ASTNode* ast = parse(parser);
-        if (ast) {
-            interpret(interpreter, ast);
-            ast_free(ast);
-        }
-        parser_free(parser);
-        free_tokens(&tokens);
+        execute_source(&session, input, (int)strlen(input), &arena);
+        output_flush();
+        arena_reset(&arena);
     }
-    interpreter_free(interpreter);
+    arena_free(&arena);
+    if (show_stats) report_stats(session.interpreter);
+    session_free(&session);
     printf("Leaving interactive mode.\n");
 }
 
+// 通常ファイルは mmap したまま字句解析する（"-" は標準入力）
 void run_file(const char* filename) {
-    FILE* file = fopen(filename, "r");
-    if (!file) { perror("Error opening file"); return; }
-    fseek(file, 0, SEEK_END);
-    long fsize = ftell(file);
-    fseek(file, 0, SEEK_SET);
-    char* content = malloc(fsize + 1);
-    fread(content, 1, fsize, file);
-    fclose(file);
-    content[fsize] = '\0';
-    TokenList tokens = tokenize(content);
-    Parser* parser = parser_create(tokens);
-    ASTNode* ast = parse(parser);
-    if (ast) {
-        Interpreter* interpreter = interpreter_create();
-        interpret(interpreter, ast);
-        interpreter_free(interpreter);
-        ast_free(ast);
+    SourceBuffer source;
+    StatsTime start = stats_now();
+    if (!source_open(&source, filename)) return;
+    phase_end(PHASE_READ, start);
+    Session session;
+    session_init(&session);
+    session.whole_script = 1;
+    if (profile_path) session.interpreter->profile = profile_create();
+    // AST を表示・走査するオプションやプロファイルは構文解析の結果を使うのでキャッシュしない
+    CacheEntry cache;
+    Program* cached = NULL;
+    if (cache_dir && !use_tree_walker && !dump_ast && !explain_types && !profile_path &&
+        cache_entry_init(&cache, cache_dir, source.data, source.length, session.interpreter->statement_markers)) {
+        start = stats_now();
+        cached = cache_load(&cache, session.interpreter);
+        phase_end(PHASE_READ, start);
+        cache_status = cached ? "hit" : "miss";
+        session.cache = cached ? NULL : &cache;
+    }
+    if (cached) {
+        start = stats_now();
+        run_program(&session, cached);
+        phase_end(PHASE_EXECUTE, start);
     } else {
-        printf("Failed to parse the file.\n");
+        Arena arena;
+        arena_init(&arena, allocator_default(), ALLOC_AST);
+        if (!execute_source(&session, source.data, (int)source.length, &arena)) printf("Failed to parse the file.\n");
+        arena_free(&arena);
     }
-    parser_free(parser);
-    free_tokens(&tokens);
-    free(content);
+    if (show_stats) report_stats(session.interpreter);
+    if (session.interpreter->profile) {
+        report_profile(session.interpreter, source.data, source.length);
+        profile_free(session.interpreter->profile);
+    }
+    session_free(&session);
+    source_close(&source);
 }
 
 int main(int argc, char* argv[]) {
-    if (argc == 1 || (argc == 2 && strcmp(argv[1], "-h") == 0)) {
-        print_help();
-        return 0;
+    const char* filename = NULL;
+    const char* output_path = NULL;
+    int interactive = 0;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-h") == 0) { print_help(); return 0; }
+        else if (strcmp(argv[i], "-i") == 0) interactive = 1;
+        else if (strcmp(argv[i], "--tree-walk") == 0) use_tree_walker = 1;
+        else if (strcmp(argv[i], "--arena-stats") == 0) show_arena_stats = 1;
+        else if (strcmp(argv[i], "--dump-ast") == 0) dump_ast = 1;
+        else if (strcmp(argv[i], "--explain-types") == 0) explain_types = 1;
+        else if (strcmp(argv[i], "--stats") == 0) show_stats = 1;
+        else if (strcmp(argv[i], "--profile") == 0 && i + 1 < argc) profile_path = argv[++i];
+        else if (strcmp(argv[i], "--cache-dir") == 0 && i + 1 < argc) cache_dir = argv[++i];
+        else if (strcmp(argv[i], "--output") == 0 && i + 1 < argc) output_path = argv[++i];
+        else if (strcmp(argv[i], "--batch") == 0 && i + 1 < argc) batch_path = argv[++i];
+        else if (strcmp(argv[i], "--jobs") == 0 && i + 1 < argc) batch_jobs = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--py-workers") == 0 && i + 1 < argc) py_workers = atoi(argv[++i]);
+        else if ((argv[i][0] != '-' || strcmp(argv[i], "-") == 0) && !filename) filename = argv[i];
+        else {
+            fprintf(stderr, "Invalid arguments. Use -h for help.\n");
+            return 1;
+        }
+    }
+    pyworker_set_pool_size(py_workers);
+    if (!cache_dir) cache_dir = getenv("STRINGS_CACHE_DIR");
+    if (cache_dir && !*cache_dir) cache_dir = NULL;
+    if (batch_path) {
+        if (filename || interactive || dump_ast || explain_types || show_stats || profile_path) {
+            fprintf(stderr, "--batch cannot be combined with a script file, -i, --dump-ast, --explain-types, --stats or --profile.\n");
+            return 1;
+        }
+        BatchOptions options = { batch_jobs, use_tree_walker, output_path, cache_dir };
+        return batch_run(batch_path, &options, stdout) == 0 ? 0 : 1;
     }
-    if (argc == 2 && strcmp(argv[1], "-i") == 0) {
+    if ((interactive || filename) && !output_open(output_path)) return 1;
+    if (interactive) {
         interactive_mode();
+        output_close();
         return 0;
     }
-    if (argc == 2) {
-        run_file(argv[1]);
+    if (filename) {
+        run_file(filename);
+        output_close();
         return 0;
     }
-    fprintf(stderr, "Invalid arguments. Use -h for help.\n");
-    return 1;
-}
\ No newline at end of file
+    print_help();
+    return 0;
+}
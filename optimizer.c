@@ -0,0 +1,157 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "optimizer.h"
+
+// --- Constant Folding ---
+// 実行時エラーを出す組み合わせ（ゼロ除算や未対応の演算子）は畳み込まず、実行時に任せる
+// （なので畳み込みではエラーの出力先を渡さない）
+static int can_fold_binary(TokenType op, const EvalResult* left, const EvalResult* right) {
+    if (left->type == RESULT_NUMBER && right->type == RESULT_NUMBER) {
+        switch (op) {
+            case TOKEN_DIVIDE: case TOKEN_YEN: case TOKEN_BACKSLASH:
+                return right->value.number != 0;
+            case TOKEN_PLUS: case TOKEN_MINUS: case TOKEN_MULTIPLY: case TOKEN_AT: case TOKEN_MOD:
+            case TOKEN_GT: case TOKEN_LT: case TOKEN_GTE: case TOKEN_LTE: case TOKEN_EQ: case TOKEN_NEQ:
+            case TOKEN_AMPERSAND: case TOKEN_PIPE:
+                return 1;
+            default:
+                return 0;
+        }
+    }
+    if (op == TOKEN_PLUS) return 1;
+    if (left->type == RESULT_NUMBER || right->type == RESULT_NUMBER) return 0;
+    switch (op) {
+        case TOKEN_GT: case TOKEN_LT: case TOKEN_GTE: case TOKEN_LTE: case TOKEN_EQ: case TOKEN_NEQ:
+            return 1;
+        default:
+            return 0;
+    }
+}
+
+static int can_fold_unary(TokenType op, const EvalResult* operand) {
+    if (operand->type == RESULT_NUMBER) return op == TOKEN_PLUS || op == TOKEN_MINUS || op == TOKEN_TILDE;
+    return op == TOKEN_TILDE;
+}
+
+static void release_string(void* string) {
+    rstring_release(string);
+}
+
+// 畳み込んだ値でノードを置き換える（value の所有権は消費される）。ソース位置は残す
+static void replace_with_constant(ASTNode* node, EvalResult value, Arena* arena) {
+    if (node->type == AST_NUMBER || node->type == AST_STRING) {
+        release_result(value);
+        return;
+    }
+    if (value.type == RESULT_NUMBER) {
+        node->type = AST_NUMBER;
+        node->data.number.value = value.value.number;
+        return;
+    }
+    RString* string = value.type == RESULT_STRING ? value.value.string
+                                                  : rstring_new(arena->allocator, value.value.short_string, value.short_length);
+    // 参照はパーサのリテラルと同じくアリーナが引き取る
+    node->type = AST_STRING;
+    node->data.string.value = string;
+    arena_defer(arena, release_string, string);
+}
+
+// 部分木が定数なら値を *value に入れて 1 を返す。
+// 定数でなければ、その中の定数部分木をノードに置き換えて 0 を返す。
+// 値のまま持ち上げるので、左結合の連結の連鎖も一時値への追記で線形に畳み込める
+static int fold_expression(ASTNode* node, EvalResult* value, Arena* arena) {
+    if (!node) return 0;
+    switch (node->type) {
+        case AST_NUMBER:
+            *value = create_number_result(node->data.number.value);
+            return 1;
+        case AST_STRING:
+            *value = share_string_result(node->data.string.value);
+            return 1;
+        case AST_BINARY_OP: {
+            EvalResult left, right;
+            int left_constant = fold_expression(node->data.binary_op.left, &left, arena);
+            int right_constant = fold_expression(node->data.binary_op.right, &right, arena);
+            if (left_constant && right_constant && can_fold_binary(node->data.binary_op.operator, &left, &right)) {
+                *value = apply_binary_op(arena->allocator, NULL, node->data.binary_op.operator, left, right);
+                return 1;
+            }
+            if (left_constant) replace_with_constant(node->data.binary_op.left, left, arena);
+            if (right_constant) replace_with_constant(node->data.binary_op.right, right, arena);
+            return 0;
+        }
+        case AST_UNARY_OP: {
+            EvalResult operand;
+            if (!fold_expression(node->data.unary_op.operand, &operand, arena)) return 0;
+            if (can_fold_unary(node->data.unary_op.operator, &operand)) {
+                *value = apply_unary_op(NULL, node->data.unary_op.operator, operand);
+                return 1;
+            }
+            replace_with_constant(node->data.unary_op.operand, operand, arena);
+            return 0;
+        }
+        default:
+            return 0;
+    }
+}
+
+// 式を畳み込む。定数になった場合は *truthy に真偽を入れて 1 を返す
+static int optimize_expression(ASTNode* node, Arena* arena, int* truthy) {
+    EvalResult value;
+    if (!fold_expression(node, &value, arena)) return 0;
+    if (truthy) *truthy = result_is_truthy(value);
+    replace_with_constant(node, value, arena);
+    return 1;
+}
+
+// --- Dead Branch Elimination ---
+static ASTNode* optimize_statement(ASTNode* node, Arena* arena);
+
+// 消えた文（NULL）を詰めて新しい文の数を返す
+static int optimize_statement_list(ASTNode** statements, int count, Arena* arena) {
+    int kept = 0;
+    for (int i = 0; i < count; i++) {
+        ASTNode* statement = optimize_statement(statements[i], arena);
+        if (statement) statements[kept++] = statement;
+    }
+    return kept;
+}
+
+static ASTNode* optimize_statement(ASTNode* node, Arena* arena) {
+    if (!node) return NULL;
+    switch (node->type) {
+        case AST_COMPOUND_STATEMENT:
+            node->data.compound_statement.statement_count = optimize_statement_list(
+                node->data.compound_statement.statements, node->data.compound_statement.statement_count, arena);
+            if (node->data.compound_statement.statement_count == 0) return NULL;
+            return node;
+        case AST_CATEGORY_DEFINITION:
+            node->data.category_definition.statement_count = optimize_statement_list(
+                node->data.category_definition.statements, node->data.category_definition.statement_count, arena);
+            return node;
+        case AST_ASSIGNMENT:
+        case AST_RE_ASSIGNMENT:
+            optimize_expression(node->data.assignment.expression, arena, NULL);
+            return node;
+        case AST_WRITE_STATEMENT:
+            optimize_expression(node->data.write_statement.expression, arena, NULL);
+            return node;
+        case AST_IF_STATEMENT: {
+            int truthy;
+            node->data.if_statement.then_stmt = optimize_statement(node->data.if_statement.then_stmt, arena);
+            node->data.if_statement.else_stmt = optimize_statement(node->data.if_statement.else_stmt, arena);
+            if (!optimize_expression(node->data.if_statement.condition, arena, &truthy)) return node;
+            return truthy ? node->data.if_statement.then_stmt : node->data.if_statement.else_stmt;
+        }
+        default:
+            // 式文は値を捨てるだけなので、定数なら文ごと消せる
+            if (node->type >= AST_NUMBER && node->type <= AST_CALL_EXPRESSION) {
+                if (optimize_expression(node, arena, NULL)) return NULL;
+            }
+            return node;
+    }
+}
+
+ASTNode* optimize(ASTNode* ast, Arena* arena) {
+    return optimize_statement(ast, arena);
+}
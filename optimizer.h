@@ -0,0 +1,11 @@
+#ifndef OPTIMIZER_H
+#define OPTIMIZER_H
+
+#include "interpreter.h"
+
+// 構文解析直後のASTを最適化する。
+// リテラルだけの式を畳み込み、条件が定数の if文を実行される側の文に置き換える。
+// 新しいノードは arena 上に作る。文がすべて消えた場合は NULL を返す
+ASTNode* optimize(ASTNode* ast, Arena* arena);
+
+#endif
@@ -0,0 +1,329 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <math.h>
+#include <errno.h>
+#include "output.h"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#endif
+
+#define OUTPUT_BUFFER_SIZE (1 << 20)
+
+int output_format_number(char* buffer, double value) {
+    // 6桁に収まる整数は %g と同じ表記になるので自前で書く
+    if (value > -1e6 && value < 1e6 && value == (double)(long)value && !(value == 0 && signbit(value))) {
+        long n = (long)value;
+        char digits[8];
+        int count = 0, length = 0;
+        unsigned long u = n < 0 ? (unsigned long)-n : (unsigned long)n;
+        do { digits[count++] = (char)('0' + u % 10); u /= 10; } while (u);
+        if (n < 0) buffer[length++] = '-';
+        while (count) buffer[length++] = digits[--count];
+        buffer[length] = '\0';
+        return length;
+    }
+    return snprintf(buffer, 32, "%g", value);
+}
+
+#ifdef _WIN32
+// スレッドなしで stdio に任せる
+static FILE* output_file = NULL;
+
+int output_open(const char* path) {
+    output_file = stdout;
+    if (path && !(output_file = fopen(path, "wb"))) { perror("Error opening output file"); output_file = stdout; return 0; }
+    return 1;
+}
+
+void output_close(void) {
+    if (!output_file) return;
+    fflush(output_file);
+    if (output_file != stdout) fclose(output_file);
+    output_file = NULL;
+}
+
+void output_flush(void) {
+    fflush(stdout);
+    if (output_file) fflush(output_file);
+}
+
+static void sink_write(const char* data, size_t length) {
+    fwrite(data, 1, length, output_file ? output_file : stdout);
+}
+#else
+typedef struct {
+    char* data;
+    size_t length;
+} OutputBuffer;
+
+// 書き込み側は active に溜め、満杯になったら pending として書き出しスレッドへ渡して
+// もう一方のバッファに切り替える
+static struct {
+    int open;
+    int fd;
+    int owns_fd;
+    int failed;         // 書き出しに失敗したら以降の出力は捨てる
+    int stop;
+    OutputBuffer buffers[2];
+    OutputBuffer* active;
+    OutputBuffer* pending;
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t ready;   // pending ができた、または stop
+    pthread_cond_t done;    // pending を書き出し終えた
+} out;
+
+static void write_all(const char* data, size_t length) {
+    while (length > 0 && !out.failed) {
+        ssize_t n = write(out.fd, data, length);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            perror("Error writing output");
+            out.failed = 1;
+            break;
+        }
+        data += n;
+        length -= (size_t)n;
+    }
+}
+
+static void* writer_thread(void* arg) {
+    (void)arg;
+    pthread_mutex_lock(&out.lock);
+    while (1) {
+        while (!out.pending && !out.stop) pthread_cond_wait(&out.ready, &out.lock);
+        if (!out.pending) break;
+        OutputBuffer* buffer = out.pending;
+        pthread_mutex_unlock(&out.lock);
+        write_all(buffer->data, buffer->length);
+        pthread_mutex_lock(&out.lock);
+        buffer->length = 0;
+        out.pending = NULL;
+        pthread_cond_broadcast(&out.done);
+    }
+    pthread_mutex_unlock(&out.lock);
+    return NULL;
+}
+
+// active を書き出しスレッドへ渡す（前の分の書き出しが終わるまで待つ）
+static void submit_active(void) {
+    pthread_mutex_lock(&out.lock);
+    while (out.pending) pthread_cond_wait(&out.done, &out.lock);
+    out.pending = out.active;
+    pthread_cond_signal(&out.ready);
+    pthread_mutex_unlock(&out.lock);
+    out.active = out.active == &out.buffers[0] ? &out.buffers[1] : &out.buffers[0];
+}
+
+static void output_close_at_exit(void) {
+    output_close();
+}
+
+int output_open(const char* path) {
+    if (out.open) return 1;
+    out.fd = STDOUT_FILENO;
+    out.owns_fd = 0;
+    if (path) {
+        out.fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (out.fd < 0) { perror("Error opening output file"); return 0; }
+        out.owns_fd = 1;
+    }
+    for (int i = 0; i < 2; i++) {
+        out.buffers[i].data = malloc(OUTPUT_BUFFER_SIZE);
+        if (!out.buffers[i].data) { perror("malloc failed"); exit(EXIT_FAILURE); }
+        out.buffers[i].length = 0;
+    }
+    out.active = &out.buffers[0];
+    out.pending = NULL;
+    out.failed = 0;
+    out.stop = 0;
+    pthread_mutex_init(&out.lock, NULL);
+    pthread_cond_init(&out.ready, NULL);
+    pthread_cond_init(&out.done, NULL);
+    if (pthread_create(&out.thread, NULL, writer_thread, NULL) != 0) {
+        perror("Error starting output thread");
+        exit(EXIT_FAILURE);
+    }
+    out.open = 1;
+    static int registered = 0;
+    if (!registered) { atexit(output_close_at_exit); registered = 1; }
+    return 1;
+}
+
+void output_flush(void) {
+    fflush(stdout);
+    if (!out.open) return;
+    if (out.active->length > 0) submit_active();
+    pthread_mutex_lock(&out.lock);
+    while (out.pending) pthread_cond_wait(&out.done, &out.lock);
+    pthread_mutex_unlock(&out.lock);
+}
+
+void output_close(void) {
+    if (!out.open) return;
+    output_flush();
+    pthread_mutex_lock(&out.lock);
+    out.stop = 1;
+    pthread_cond_signal(&out.ready);
+    pthread_mutex_unlock(&out.lock);
+    pthread_join(out.thread, NULL);
+    pthread_mutex_destroy(&out.lock);
+    pthread_cond_destroy(&out.ready);
+    pthread_cond_destroy(&out.done);
+    free(out.buffers[0].data);
+    free(out.buffers[1].data);
+    if (out.owns_fd) close(out.fd);
+    out.open = 0;
+}
+
+static void sink_write(const char* data, size_t length) {
+    if (!out.open) { fwrite(data, 1, length, stdout); return; }
+    while (length > 0) {
+        size_t space = OUTPUT_BUFFER_SIZE - out.active->length;
+        size_t n = length < space ? length : space;
+        memcpy(out.active->data + out.active->length, data, n);
+        out.active->length += n;
+        data += n;
+        length -= n;
+        if (out.active->length == OUTPUT_BUFFER_SIZE) submit_active();
+    }
+}
+#endif
+
+// --- Capture ---
+void output_capture_init(OutputCapture* capture) {
+    capture->data = NULL;
+    capture->length = 0;
+    capture->capacity = 0;
+    capture->last = 0;
+}
+
+static void capture_reserve(OutputCapture* capture, size_t needed) {
+    if (capture->length + needed <= capture->capacity) return;
+    size_t capacity = capture->capacity ? capture->capacity * 2 : 4096;
+    while (capacity < capture->length + needed) capacity *= 2;
+    char* grown = realloc(capture->data, capacity);
+    if (!grown) { perror("realloc failed"); exit(EXIT_FAILURE); }
+    capture->data = grown;
+    capture->capacity = capacity;
+}
+
+static void capture_append(OutputCapture* capture, OutputStream stream, const char* data, size_t length) {
+    size_t header = 1 + sizeof(size_t);
+    if (stream == OUTPUT_STDOUT && capture->last) {
+        // 直前の記録が標準出力で、その後ろに何もなければ伸ばす
+        size_t record_length;
+        memcpy(&record_length, capture->data + capture->last, sizeof(size_t));
+        if (capture->last + sizeof(size_t) + record_length == capture->length) {
+            capture_reserve(capture, length);
+            memcpy(capture->data + capture->length, data, length);
+            capture->length += length;
+            record_length += length;
+            memcpy(capture->data + capture->last, &record_length, sizeof(size_t));
+            return;
+        }
+    }
+    capture_reserve(capture, header + length);
+    capture->data[capture->length] = (char)stream;
+    memcpy(capture->data + capture->length + 1, &length, sizeof(size_t));
+    memcpy(capture->data + capture->length + header, data, length);
+    capture->last = stream == OUTPUT_STDOUT ? capture->length + 1 : 0;
+    capture->length += header + length;
+}
+
+static void capture_write_stdout(void* context, const char* data, size_t length) {
+    capture_append(context, OUTPUT_STDOUT, data, length);
+}
+
+static void capture_write_stderr(void* context, const char* data, size_t length) {
+    capture_append(context, OUTPUT_STDERR, data, length);
+}
+
+OutputSink output_capture_sink(OutputCapture* capture, OutputStream stream) {
+    OutputSink sink = { stream == OUTPUT_STDOUT ? capture_write_stdout : capture_write_stderr, capture };
+    return sink;
+}
+
+void output_capture_replay(OutputCapture* capture, const OutputSink* output, const OutputSink* errors) {
+    size_t header = 1 + sizeof(size_t);
+    for (size_t at = 0; at < capture->length;) {
+        size_t length;
+        memcpy(&length, capture->data + at + 1, sizeof(size_t));
+        const char* data = capture->data + at + header;
+        output_write(capture->data[at] == OUTPUT_STDOUT ? output : errors, data, length);
+        at += header + length;
+    }
+    free(capture->data);
+    output_capture_init(capture);
+}
+
+// --- Sinks ---
+static void stdout_sink_write(void* context, const char* data, size_t length) {
+    (void)context;
+    sink_write(data, length);
+}
+
+static void stderr_sink_write(void* context, const char* data, size_t length) {
+    (void)context;
+    output_flush();
+    fwrite(data, 1, length, stderr);
+}
+
+static void file_sink_write(void* context, const char* data, size_t length) {
+    fwrite(data, 1, length, context);
+}
+
+OutputSink output_stdout_sink(void) {
+    OutputSink sink = { stdout_sink_write, NULL };
+    return sink;
+}
+
+OutputSink output_stderr_sink(void) {
+    OutputSink sink = { stderr_sink_write, NULL };
+    return sink;
+}
+
+OutputSink output_file_sink(FILE* file) {
+    OutputSink sink = { file_sink_write, file };
+    return sink;
+}
+
+void output_write(const OutputSink* sink, const char* data, size_t length) {
+    sink->write(sink->context, data, length);
+}
+
+void output_line(const OutputSink* sink, const char* data, size_t length) {
+    sink->write(sink->context, data, length);
+    sink->write(sink->context, "\n", 1);
+}
+
+void output_number_line(const OutputSink* sink, double value) {
+    char buffer[40];
+    int length = output_format_number(buffer, value);
+    buffer[length++] = '\n';
+    sink->write(sink->context, buffer, (size_t)length);
+}
+
+void output_error(const OutputSink* sink, const char* format, ...) {
+    if (!sink) return;
+    char buffer[512];
+    va_list args;
+    va_start(args, format);
+    int length = vsnprintf(buffer, sizeof(buffer), format, args);
+    va_end(args);
+    if (length < 0) return;
+    if ((size_t)length < sizeof(buffer)) { sink->write(sink->context, buffer, (size_t)length); return; }
+    // 長い名前を含むメッセージは切り詰めずにヒープで組み立てる
+    char* message = malloc((size_t)length + 1);
+    if (!message) { perror("malloc failed"); exit(EXIT_FAILURE); }
+    va_start(args, format);
+    vsnprintf(message, (size_t)length + 1, format, args);
+    va_end(args);
+    sink->write(sink->context, message, (size_t)length);
+    free(message);
+}
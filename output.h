@@ -0,0 +1,51 @@
+#ifndef OUTPUT_H
+#define OUTPUT_H
+
+#include <stddef.h>
+#include <stdio.h>
+
+typedef enum { OUTPUT_STDOUT, OUTPUT_STDERR } OutputStream;
+
+// 出力先。インタプリタ・パーサはそれぞれ自分の出力先を持ち、プロセスの標準出力へ直接は書かない。
+// write は data の length バイト（NUL終端ではない）を書く
+typedef struct {
+    void (*write)(void* context, const char* data, size_t length);
+    void* context;
+} OutputSink;
+
+// プロセスの標準出力。大きな二重バッファに溜め、書き出しは専用スレッドが write(2) で行う。
+// 1つのスレッドからだけ使うこと。終了時には output_flush() で書き出しを済ませる
+int output_open(const char* path);  // NULL なら標準出力。失敗したら 0 を返す
+void output_close(void);
+void output_flush(void);             // stdio の stdout も含めて書き出しが終わるまで待つ
+
+// 既定の出力先
+OutputSink output_stdout_sink(void);        // output_open() で開いた出力（開いていなければ stdio の stdout）
+OutputSink output_stderr_sink(void);        // 上の出力を書き出してから stderr に書く
+OutputSink output_file_sink(FILE* file);    // stdio のストリームへそのまま書く
+
+void output_write(const OutputSink* sink, const char* data, size_t length);
+void output_line(const OutputSink* sink, const char* data, size_t length);     // 末尾に改行を付ける
+void output_number_line(const OutputSink* sink, double value);
+// printf 形式のメッセージを sink へ書く。sink が NULL なら捨てる
+void output_error(const OutputSink* sink, const char* format, ...);
+
+// %g と同じ書式で数値を書き、長さを返す（buffer は 32 バイト以上）
+int output_format_number(char* buffer, double value);
+
+// prun のワーカーの出力（エラーを含む）を溜めるバッファ。
+// 記録は [OutputStream 1 バイト][長さ size_t][内容] の並びで、続けて書いた標準出力は1つの記録にまとめる
+typedef struct {
+    char* data;
+    size_t length;
+    size_t capacity;
+    size_t last;    // 直前の標準出力の記録の位置+1（0 = なし）
+} OutputCapture;
+
+void output_capture_init(OutputCapture* capture);
+// capture の stream 側の記録として溜める出力先
+OutputSink output_capture_sink(OutputCapture* capture, OutputStream stream);
+// 溜めた出力を記録の順に output / errors へ書いて capture を解放する
+void output_capture_replay(OutputCapture* capture, const OutputSink* output, const OutputSink* errors);
+
+#endif
@@ -0,0 +1,179 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "parallel.h"
+#include "vm.h"
+#include "profile.h"
+#include "output.h"
+
+// 1つのカテゴリの実行。parallel_run が prun ごとに配列で確保する
+typedef struct Task {
+    Interpreter* interpreter;   // prun を実行した文脈
+    int slot;
+    OutputCapture output;
+    Profile* profile;           // --profile のときのタスク自身の計測（合流後に親へ足す）
+    int* remaining;             // 同じ prun の未完了タスク数
+    struct Task* next;          // 待ち行列
+} Task;
+
+// ワーカーの出力はタスクごとに溜め、合流後に prun の順で起動元の出力先へ書く
+static void run_task(Task* task) {
+    Interpreter* worker = interpreter_create_worker(task->interpreter);
+    worker->output = output_capture_sink(&task->output, OUTPUT_STDOUT);
+    worker->errors = output_capture_sink(&task->output, OUTPUT_STDERR);
+    if (task->interpreter->profile) worker->profile = task->profile = profile_create_worker(task->interpreter->profile);
+    VM* vm = vm_create(worker);
+    vm_run_category(vm, task->slot);
+    vm_free(vm);
+    if (worker->profile) profile_stop(worker->profile);
+    interpreter_free_worker(worker);
+}
+
+#ifdef _WIN32
+// スレッドなしで順に実行する
+void parallel_lock_slot(int slot) { (void)slot; }
+void parallel_unlock_slot(int slot) { (void)slot; }
+int parallel_default_threads(void) { return 1; }
+
+static void run_tasks(Task* tasks, int count) {
+    for (int i = 0; i < count; i++) run_task(&tasks[i]);
+}
+#else
+#include <unistd.h>
+#include <pthread.h>
+
+// 共有変数表のロックはスロット番号で振り分ける
+#define LOCK_STRIPES 64
+#define WORKER_STACK_SIZE (8 * 1024 * 1024)   // run の深い再帰に備えてメインスレッドと同程度
+
+// プールのスレッドは最初の prun で作り、プロセスの終了まで待機し続ける。
+// prun を実行したスレッドも合流を待つ間は待ち行列のタスクを実行する（入れ子の prun でも詰まらない）
+static struct {
+    pthread_once_t once;
+    pthread_mutex_t lock;
+    pthread_cond_t work;        // 待ち行列にタスクが入った
+    pthread_cond_t finished;    // どこかの prun のタスクが終わった
+    Task* head;
+    Task* tail;
+    int threads;
+    pthread_mutex_t stripes[LOCK_STRIPES];
+} pool = { PTHREAD_ONCE_INIT };
+
+void parallel_lock_slot(int slot) {
+    pthread_mutex_lock(&pool.stripes[slot % LOCK_STRIPES]);
+}
+
+void parallel_unlock_slot(int slot) {
+    pthread_mutex_unlock(&pool.stripes[slot % LOCK_STRIPES]);
+}
+
+// pool.lock を持って呼ぶ
+static Task* take_task(void) {
+    Task* task = pool.head;
+    if (task) {
+        pool.head = task->next;
+        if (!pool.head) pool.tail = NULL;
+    }
+    return task;
+}
+
+// pool.lock を持って呼び、持ったまま戻る
+static void execute_task(Task* task) {
+    pthread_mutex_unlock(&pool.lock);
+    run_task(task);
+    pthread_mutex_lock(&pool.lock);
+    if (--*task->remaining == 0) pthread_cond_broadcast(&pool.finished);
+}
+
+static void* worker_thread(void* arg) {
+    (void)arg;
+    pthread_mutex_lock(&pool.lock);
+    while (1) {
+        Task* task = take_task();
+        if (task) execute_task(task);
+        else pthread_cond_wait(&pool.work, &pool.lock);
+    }
+    return NULL;
+}
+
+int parallel_default_threads(void) {
+    const char* env = getenv("STRINGS_THREADS");
+    long threads = env && *env ? strtol(env, NULL, 10) : sysconf(_SC_NPROCESSORS_ONLN);
+    if (threads < 1) threads = 1;
+    if (threads > 256) threads = 256;
+    return (int)threads;
+}
+
+// スレッド数は prun を実行するスレッドを含めて parallel_default_threads()
+static void pool_init(void) {
+    pthread_mutex_init(&pool.lock, NULL);
+    pthread_cond_init(&pool.work, NULL);
+    pthread_cond_init(&pool.finished, NULL);
+    for (int i = 0; i < LOCK_STRIPES; i++) pthread_mutex_init(&pool.stripes[i], NULL);
+    int threads = parallel_default_threads();
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setstacksize(&attr, WORKER_STACK_SIZE);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    for (int i = 1; i < threads; i++) {
+        pthread_t thread;
+        if (pthread_create(&thread, &attr, worker_thread, NULL) != 0) {
+            perror("Error starting worker thread");
+            break;
+        }
+        pool.threads++;
+    }
+    pthread_attr_destroy(&attr);
+}
+
+static void run_tasks(Task* tasks, int count) {
+    pthread_once(&pool.once, pool_init);
+    if (pool.threads == 0) {
+        for (int i = 0; i < count; i++) run_task(&tasks[i]);
+        return;
+    }
+    int remaining = count;
+    pthread_mutex_lock(&pool.lock);
+    for (int i = 0; i < count; i++) {
+        tasks[i].remaining = &remaining;
+        tasks[i].next = NULL;
+        if (pool.tail) pool.tail->next = &tasks[i];
+        else pool.head = &tasks[i];
+        pool.tail = &tasks[i];
+    }
+    pthread_cond_broadcast(&pool.work);
+    while (remaining > 0) {
+        Task* task = take_task();
+        if (task) execute_task(task);
+        else pthread_cond_wait(&pool.finished, &pool.lock);
+    }
+    pthread_mutex_unlock(&pool.lock);
+}
+#endif
+
+void parallel_run(Interpreter* interpreter, const int* slots, int count) {
+    Task* tasks = malloc(sizeof(Task) * (size_t)(count > 0 ? count : 1));
+    if (!tasks) { perror("malloc failed"); exit(EXIT_FAILURE); }
+    int queued = 0;
+    for (int i = 0; i < count; i++) {
+        Category* category = &interpreter->categories[slots[i]];
+        if (!category->defined) {
+            output_error(&interpreter->errors, "Runtime error: Undefined category '%s'\n", category->name);
+            continue;
+        }
+        tasks[queued].interpreter = interpreter;
+        tasks[queued].slot = slots[i];
+        output_capture_init(&tasks[queued].output);
+        tasks[queued].profile = NULL;
+        queued++;
+    }
+    run_tasks(tasks, queued);
+    for (int i = 0; i < queued; i++) {
+        output_capture_replay(&tasks[i].output, &interpreter->output, &interpreter->errors);
+        if (tasks[i].profile) {
+            profile_merge(interpreter->profile, tasks[i].profile);
+            profile_free(tasks[i].profile);
+        }
+    }
+    free(tasks);
+}
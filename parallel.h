@@ -0,0 +1,18 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include "interpreter.h"
+
+// prun a b c: カテゴリをワーカースレッドのプールで並行に実行し、すべて終わるまで待つ。
+// 各カテゴリは interpreter_create_worker() の文脈で走り、ローカル変数への代入はその中に閉じる。
+// 出力はカテゴリごとに溜めて、合流時に prun に書いた順で書き出す
+void parallel_run(Interpreter* interpreter, const int* slots, int count);
+
+// 共有変数表のスロットごとのロック（ワーカーの文脈からのみ取る）
+void parallel_lock_slot(int slot);
+void parallel_unlock_slot(int slot);
+
+// 既定のスレッド数。STRINGS_THREADS、なければ CPU 数（1〜256）
+int parallel_default_threads(void);
+
+#endif
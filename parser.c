@@ -2,30 +2,74 @@
 #include <stdlib.h>
 #include <string.h>
 #include "parser.h"
+#include "stats.h"
 
 // --- Forward Declarations ---
 ASTNode* parse_expression(Parser* parser);
 ASTNode* parse_statement(Parser* parser);
 
 // --- Parser Utilities ---
-Parser* parser_create(TokenList tokens) {
-    Parser* parser = malloc(sizeof(Parser));
-    parser->tokens = tokens;
-    parser->position = 0;
-    parser->current_token = tokens.count > 0 ? tokens.tokens[0] : (Token){TOKEN_EOF, NULL, 0, 0};
+// トークンは字句解析器から必要な分だけ引き出す。コメントはここで読み捨てる
+static Token parser_pull(Parser* parser) {
+    if (parser->lexer_done) return (Token){TOKEN_EOF, parser->lexer.position, 0};
+    Token token;
+    do {
+        token = lexer_next_token(&parser->lexer);
+    } while (token.type == TOKEN_COMMENT);
+    if (token.type == TOKEN_EOF || token.type == TOKEN_ERROR) parser->lexer_done = 1;
+    return token;
+}
+
+Parser* parser_create(const char* source, int length, Arena* arena, Allocator* allocator) {
+    Parser* parser = allocator_alloc(allocator, sizeof(Parser), ALLOC_AST);
+    parser->allocator = allocator;
+    lexer_init(&parser->lexer, source, length);
+    parser->lexer_done = 0;
+    parser->lookahead_start = 0;
+    parser->lookahead_count = 0;
+    parser->source = source;
+    parser->arena = arena;
+    parser->errors = output_file_sink(stdout);
+    parser->current_token = parser_pull(parser);
     return parser;
 }
 
 void parser_free(Parser* parser) {
-    if (parser) free(parser);
+    if (parser) allocator_free(parser->allocator, parser, sizeof(Parser), ALLOC_AST);
+}
+
+// current_token の n 個先のトークン（1 <= n <= PARSER_LOOKAHEAD）
+Token parser_peek(Parser* parser, int n) {
+    while (parser->lookahead_count < n) {
+        int index = (parser->lookahead_start + parser->lookahead_count) % PARSER_LOOKAHEAD;
+        parser->lookahead[index] = parser_pull(parser);
+        parser->lookahead_count++;
+    }
+    return parser->lookahead[(parser->lookahead_start + n - 1) % PARSER_LOOKAHEAD];
 }
 
 void parser_advance(Parser* parser) {
-    parser->position++;
-    if (parser->position < parser->tokens.count)
-        parser->current_token = parser->tokens.tokens[parser->position];
-    else
-        parser->current_token.type = TOKEN_EOF;
+    if (parser->lookahead_count > 0) {
+        parser->current_token = parser->lookahead[parser->lookahead_start];
+        parser->lookahead_start = (parser->lookahead_start + 1) % PARSER_LOOKAHEAD;
+        parser->lookahead_count--;
+    } else {
+        parser->current_token = parser_pull(parser);
+    }
+}
+
+// 現在のトークンの文字列をアリーナへコピーする
+static char* parser_token_text(Parser* parser) {
+    return arena_strndup(parser->arena, parser->source + parser->current_token.start, parser->current_token.length);
+}
+
+static double parser_token_number(Parser* parser) {
+    char buffer[64];
+    int length = parser->current_token.length;
+    if (length >= (int)sizeof(buffer)) return atof(parser_token_text(parser));
+    memcpy(buffer, parser->source + parser->current_token.start, length);
+    buffer[length] = '\0';
+    return atof(buffer);
 }
 
 int parser_expect(Parser* parser, TokenType expected) {
@@ -33,76 +77,33 @@ int parser_expect(Parser* parser, TokenType expected) {
         parser_advance(parser);
         return 1;
     } else {
-        printf("Parse error at line %d, column %d: Expected %s, got %s\n",
-               parser->current_token.line, parser->current_token.column,
-               token_to_string(expected), token_to_string(parser->current_token.type));
+        int line, column;
+        lexer_position(parser->source, parser->current_token.start, &line, &column);
+        output_error(&parser->errors, "Parse error at line %d, column %d: Expected %s, got %s\n",
+               line, column, token_to_string(expected), token_to_string(parser->current_token.type));
         return 0;
     }
 }
 
-ASTNode* ast_create_node(ASTNodeType type) {
-    ASTNode* node = malloc(sizeof(ASTNode));
-    if (!node) { perror("malloc failed"); exit(EXIT_FAILURE);}
+ASTNode* ast_create_node(Arena* arena, ASTNodeType type) {
+    ASTNode* node = arena_alloc(arena, sizeof(ASTNode));
     node->type = type;
+    node->offset = -1;
+    STATS_INC(ast_nodes[type]);
     return node;
 }
 
-void ast_free(ASTNode* node) {
-    if (!node) return;
-    switch (node->type) {
-        case AST_NUMBER: break;
-        case AST_STRING: if (node->data.string.value) free(node->data.string.value); break;
-        case AST_IDENTIFIER: if (node->data.identifier.name) free(node->data.identifier.name); break;
-        case AST_BINARY_OP:
-            ast_free(node->data.binary_op.left);
-            ast_free(node->data.binary_op.right);
-            break;
-        case AST_UNARY_OP:
-            ast_free(node->data.unary_op.operand);
-            break;
-        case AST_ASSIGNMENT:
-        case AST_RE_ASSIGNMENT:
-        case AST_SUNUM_STATEMENT:
-            if (node->data.assignment.variable) free(node->data.assignment.variable);
-            ast_free(node->data.assignment.expression);
-            break;
-        case AST_NUM_WRITE_STATEMENT:
-            if (node->data.num_write_statement.variable_name) free(node->data.num_write_statement.variable_name);
-            break;
-        case AST_IF_STATEMENT:
-            ast_free(node->data.if_statement.condition);
-            ast_free(node->data.if_statement.then_stmt);
-            ast_free(node->data.if_statement.else_stmt);
-            break;
-        case AST_COMPOUND_STATEMENT:
-            for (int i = 0; i < node->data.compound_statement.statement_count; i++)
-                ast_free(node->data.compound_statement.statements[i]);
-            if (node->data.compound_statement.statements) free(node->data.compound_statement.statements);
-            break;
-        case AST_WRITE_STATEMENT:
-            ast_free(node->data.write_statement.expression);
-            break;
-        case AST_RUN_STATEMENT:
-            if (node->data.run_statement.category_name) free(node->data.run_statement.category_name);
-            break;
-        case AST_CALL_STATEMENT:
-            if (node->data.call_statement.language) free(node->data.call_statement.language);
-            if (node->data.call_statement.code) free(node->data.call_statement.code);
-            break;
-        case AST_FUNCTION_CALL:
-            if (node->data.function_call.function_name) free(node->data.function_call.function_name);
-            for (int i = 0; i < node->data.function_call.arg_count; i++)
-                ast_free(node->data.function_call.arguments[i]);
-            if (node->data.function_call.arguments) free(node->data.function_call.arguments);
-            break;
-        case AST_CATEGORY_DEFINITION:
-            if (node->data.category_definition.name) free(node->data.category_definition.name);
-            for (int i = 0; i < node->data.category_definition.statement_count; i++)
-                ast_free(node->data.category_definition.statements[i]);
-            if (node->data.category_definition.statements) free(node->data.category_definition.statements);
-            break;
-    }
-    free(node);
+static void parser_release_string(void* string) {
+    rstring_release(string);
+}
+
+// 文字列リテラルは実行時の値とそのまま共有するので、アリーナではなく参照カウントで持つ。
+// string の参照はアリーナが引き取り、解放時に手放す
+ASTNode* ast_create_string_node(Arena* arena, RString* string) {
+    ASTNode* node = ast_create_node(arena, AST_STRING);
+    node->data.string.value = string;
+    arena_defer(arena, parser_release_string, string);
+    return node;
 }
 
 // --- Expression Parsing ---
@@ -110,30 +111,36 @@ ASTNode* parse_primary(Parser* parser) {
     ASTNode* node = NULL;
     switch (parser->current_token.type) {
         case TOKEN_NUMBER:
-            node = ast_create_node(AST_NUMBER);
-            node->data.number.value = atof(parser->current_token.value);
+            node = ast_create_node(parser->arena, AST_NUMBER);
+            node->data.number.value = parser_token_number(parser);
             parser_advance(parser);
             break;
         case TOKEN_STRING:
-            node = ast_create_node(AST_STRING);
-            node->data.string.value = strdup(parser->current_token.value);
+            node = ast_create_string_node(parser->arena,
+                rstring_new(parser->allocator, parser->source + parser->current_token.start, parser->current_token.length));
             parser_advance(parser);
             break;
         case TOKEN_IDENTIFIER:
-            node = ast_create_node(AST_IDENTIFIER);
-            node->data.identifier.name = strdup(parser->current_token.value);
+            node = ast_create_node(parser->arena, AST_IDENTIFIER);
+            node->data.identifier.name = parser_token_text(parser);
+            node->data.identifier.slot = -1;
             parser_advance(parser);
             break;
         case TOKEN_LPAREN:
             parser_advance(parser);
             node = parse_expression(parser);
-            if (!parser_expect(parser, TOKEN_RPAREN)) { ast_free(node); return NULL; }
+            if (!parser_expect(parser, TOKEN_RPAREN)) return NULL;
             break;
-        default:
-            printf("Parse error at line %d, column %d: Expected expression start, got %s\n",
-                   parser->current_token.line, parser->current_token.column,
-                   token_to_string(parser->current_token.type));
+        case TOKEN_CALL:
+            node = parse_call(parser, AST_CALL_EXPRESSION);
+            break;
+        default: {
+            int line, column;
+            lexer_position(parser->source, parser->current_token.start, &line, &column);
+            output_error(&parser->errors, "Parse error at line %d, column %d: Expected expression start, got %s\n",
+                   line, column, token_to_string(parser->current_token.type));
             return NULL;
+        }
     }
     return node;
 }
@@ -144,7 +151,7 @@ ASTNode* parse_unary(Parser* parser) {
         parser_advance(parser);
         ASTNode* operand = parse_unary(parser);
         if (!operand) return NULL;
-        ASTNode* node = ast_create_node(AST_UNARY_OP);
+        ASTNode* node = ast_create_node(parser->arena, AST_UNARY_OP);
         node->data.unary_op.operator = op_type;
         node->data.unary_op.operand = operand;
         return node;
@@ -164,8 +171,8 @@ ASTNode* parse_term(Parser* parser) {
         TokenType op_type = parser->current_token.type;
         parser_advance(parser);
         ASTNode* right = parse_unary(parser);
-        if (!right) { ast_free(node); return NULL;}
-        ASTNode* new_node = ast_create_node(AST_BINARY_OP);
+        if (!right) return NULL;
+        ASTNode* new_node = ast_create_node(parser->arena, AST_BINARY_OP);
         new_node->data.binary_op.operator = op_type;
         new_node->data.binary_op.left = node;
         new_node->data.binary_op.right = right;
@@ -182,8 +189,8 @@ ASTNode* parse_additive(Parser* parser) {
         TokenType op_type = parser->current_token.type;
         parser_advance(parser);
         ASTNode* right = parse_term(parser);
-        if (!right) { ast_free(node); return NULL;}
-        ASTNode* new_node = ast_create_node(AST_BINARY_OP);
+        if (!right) return NULL;
+        ASTNode* new_node = ast_create_node(parser->arena, AST_BINARY_OP);
         new_node->data.binary_op.operator = op_type;
         new_node->data.binary_op.left = node;
         new_node->data.binary_op.right = right;
@@ -204,8 +211,8 @@ ASTNode* parse_comparison(Parser* parser) {
         TokenType op_type = parser->current_token.type;
         parser_advance(parser);
         ASTNode* right = parse_additive(parser);
-        if (!right) { ast_free(node); return NULL;}
-        ASTNode* new_node = ast_create_node(AST_BINARY_OP);
+        if (!right) return NULL;
+        ASTNode* new_node = ast_create_node(parser->arena, AST_BINARY_OP);
         new_node->data.binary_op.operator = op_type;
         new_node->data.binary_op.left = node;
         new_node->data.binary_op.right = right;
@@ -222,8 +229,8 @@ ASTNode* parse_logical(Parser* parser) {
         TokenType op_type = parser->current_token.type;
         parser_advance(parser);
         ASTNode* right = parse_comparison(parser);
-        if (!right) { ast_free(node); return NULL;}
-        ASTNode* new_node = ast_create_node(AST_BINARY_OP);
+        if (!right) return NULL;
+        ASTNode* new_node = ast_create_node(parser->arena, AST_BINARY_OP);
         new_node->data.binary_op.operator = op_type;
         new_node->data.binary_op.left = node;
         new_node->data.binary_op.right = right;
@@ -239,14 +246,10 @@ ASTNode* parse_expression(Parser* parser) {
 // --- if-else文のパース ---
 //   条件式 / ? then文 / ! else文 //
 //   then文・else文の末尾 / はあってもなくても良い
-ASTNode* parse_if_statement(Parser* parser) {
-    ASTNode* condition = parse_expression(parser);
-    if (!condition) return NULL;
-    if (!parser_expect(parser, TOKEN_CMD_END)) { ast_free(condition); return NULL; }
-    if (!parser_expect(parser, TOKEN_IF)) { ast_free(condition); return NULL; }
-
+// 条件式と "/ ?" は読み終えた状態で呼ばれる
+ASTNode* parse_if_statement_after_condition(Parser* parser, ASTNode* condition) {
     ASTNode* then_stmt = parse_statement(parser);
-    if (!then_stmt) { ast_free(condition); return NULL; }
+    if (!then_stmt) return NULL;
     // then文の後に / があれば読み飛ばす（あってもなくてもOK）
     if (parser->current_token.type == TOKEN_CMD_END) parser_advance(parser);
 
@@ -254,25 +257,32 @@ ASTNode* parse_if_statement(Parser* parser) {
     if (parser->current_token.type == TOKEN_ELSE) {
         parser_advance(parser);
         else_stmt = parse_statement(parser);
-        if (!else_stmt) { ast_free(condition); ast_free(then_stmt); return NULL; }
+        if (!else_stmt) return NULL;
         if (parser->current_token.type == TOKEN_CMD_END) parser_advance(parser);
     }
 
-    ASTNode* if_node = ast_create_node(AST_IF_STATEMENT);
+    ASTNode* if_node = ast_create_node(parser->arena, AST_IF_STATEMENT);
     if_node->data.if_statement.condition = condition;
     if_node->data.if_statement.then_stmt = then_stmt;
     if_node->data.if_statement.else_stmt = else_stmt;
     return if_node;
 }
 
+ASTNode* parse_if_statement(Parser* parser) {
+    ASTNode* condition = parse_expression(parser);
+    if (!condition) return NULL;
+    if (!parser_expect(parser, TOKEN_CMD_END)) return NULL;
+    if (!parser_expect(parser, TOKEN_IF)) return NULL;
+    return parse_if_statement_after_condition(parser, condition);
+}
+
 // --- Statement End ---
 ASTNode* parse_statement_end(Parser* parser, ASTNode* node) {
     if (parser->current_token.type == TOKEN_CMD_END) {
         parser_advance(parser);
         return node;
     } else {
-        printf("Parse error: Expected / after statement, got %s\n", token_to_string(parser->current_token.type));
-        ast_free(node);
+        output_error(&parser->errors, "Parse error: Expected / after statement, got %s\n", token_to_string(parser->current_token.type));
         return NULL;
     }
 }
@@ -282,7 +292,7 @@ ASTNode* parse_write_statement(Parser* parser) {
     if (!parser_expect(parser, TOKEN_WRITE)) return NULL;
     ASTNode* expression = parse_expression(parser);
     if (!expression) return NULL;
-    ASTNode* node = ast_create_node(AST_WRITE_STATEMENT);
+    ASTNode* node = ast_create_node(parser->arena, AST_WRITE_STATEMENT);
     node->data.write_statement.expression = expression;
     return node;
 }
@@ -291,138 +301,176 @@ ASTNode* parse_num_write_statement(Parser* parser) {
     if (!parser_expect(parser, TOKEN_NUM)) return NULL;
     if (!parser_expect(parser, TOKEN_WRITE)) return NULL;
     if (parser->current_token.type != TOKEN_IDENTIFIER) {
-        printf("Parse error: Expected identifier after 'num write'\n");
+        output_error(&parser->errors, "Parse error: Expected identifier after 'num write'\n");
         return NULL;
     }
-    ASTNode* node = ast_create_node(AST_NUM_WRITE_STATEMENT);
-    node->data.num_write_statement.variable_name = strdup(parser->current_token.value);
+    ASTNode* node = ast_create_node(parser->arena, AST_NUM_WRITE_STATEMENT);
+    node->data.num_write_statement.variable_name = parser_token_text(parser);
+    node->data.num_write_statement.slot = -1;
     parser_advance(parser);
     return node;
 }
 
 ASTNode* parse_assignment(Parser* parser) {
     if (parser->current_token.type != TOKEN_IDENTIFIER) {
-        printf("Parse error: Expected identifier for assignment\n");
+        output_error(&parser->errors, "Parse error: Expected identifier for assignment\n");
         return NULL;
     }
-    char* var_name = strdup(parser->current_token.value);
+    char* var_name = parser_token_text(parser);
     parser_advance(parser);
-    if (!parser_expect(parser, TOKEN_ASSIGN)) { free(var_name); return NULL;}
+    if (!parser_expect(parser, TOKEN_ASSIGN)) return NULL;
     ASTNode* expression = parse_expression(parser);
-    if (!expression) { free(var_name); return NULL;}
-    ASTNode* node = ast_create_node(AST_ASSIGNMENT);
+    if (!expression) return NULL;
+    ASTNode* node = ast_create_node(parser->arena, AST_ASSIGNMENT);
     node->data.assignment.variable = var_name;
     node->data.assignment.expression = expression;
+    node->data.assignment.slot = -1;
     return node;
 }
 
 ASTNode* parse_re_assignment_statement(Parser* parser) {
     if (!parser_expect(parser, TOKEN_RE)) return NULL;
     if (parser->current_token.type != TOKEN_IDENTIFIER) {
-        printf("Parse error: Expected identifier for re-assignment\n");
+        output_error(&parser->errors, "Parse error: Expected identifier for re-assignment\n");
         return NULL;
     }
-    char* var_name = strdup(parser->current_token.value);
+    char* var_name = parser_token_text(parser);
     parser_advance(parser);
-    if (!parser_expect(parser, TOKEN_ASSIGN)) { free(var_name); return NULL;}
+    if (!parser_expect(parser, TOKEN_ASSIGN)) return NULL;
     ASTNode* expression = parse_expression(parser);
-    if (!expression) { free(var_name); return NULL;}
-    ASTNode* node = ast_create_node(AST_RE_ASSIGNMENT);
+    if (!expression) return NULL;
+    ASTNode* node = ast_create_node(parser->arena, AST_RE_ASSIGNMENT);
     node->data.assignment.variable = var_name;
     node->data.assignment.expression = expression;
+    node->data.assignment.slot = -1;
     return node;
 }
 
 ASTNode* parse_sunum_statement(Parser* parser) {
     if (!parser_expect(parser, TOKEN_SUNUM)) return NULL;
     if (parser->current_token.type != TOKEN_IDENTIFIER) {
-        printf("Parse error: Expected identifier for sunum statement\n");
+        output_error(&parser->errors, "Parse error: Expected identifier for sunum statement\n");
         return NULL;
     }
-    char* var_name = strdup(parser->current_token.value);
+    char* var_name = parser_token_text(parser);
     parser_advance(parser);
-    ASTNode* node = ast_create_node(AST_SUNUM_STATEMENT);
+    ASTNode* node = ast_create_node(parser->arena, AST_SUNUM_STATEMENT);
     node->data.assignment.variable = var_name;
     node->data.assignment.expression = NULL;
+    node->data.assignment.slot = -1;
     return node;
 }
 
 ASTNode* parse_run_statement(Parser* parser) {
     if (!parser_expect(parser, TOKEN_RUN)) return NULL;
     if (parser->current_token.type != TOKEN_IDENTIFIER) {
-        printf("Parse error: Expected category name for run statement\n");
+        output_error(&parser->errors, "Parse error: Expected category name for run statement\n");
         return NULL;
     }
-    ASTNode* node = ast_create_node(AST_RUN_STATEMENT);
-    node->data.run_statement.category_name = strdup(parser->current_token.value);
+    ASTNode* node = ast_create_node(parser->arena, AST_RUN_STATEMENT);
+    node->data.run_statement.category_name = parser_token_text(parser);
+    node->data.run_statement.slot = -1;
     parser_advance(parser);
     return node;
 }
 
-ASTNode* parse_call_statement(Parser* parser) {
+// prun a b c /
+ASTNode* parse_parallel_run_statement(Parser* parser) {
+    if (!parser_expect(parser, TOKEN_PRUN)) return NULL;
+    if (parser->current_token.type != TOKEN_IDENTIFIER) {
+        output_error(&parser->errors, "Parse error: Expected category names for prun statement\n");
+        return NULL;
+    }
+    int count = 0, capacity = 4;
+    char** names = arena_alloc(parser->arena, sizeof(char*) * capacity);
+    while (parser->current_token.type == TOKEN_IDENTIFIER) {
+        if (count >= capacity) {
+            names = arena_grow(parser->arena, names, sizeof(char*) * capacity, sizeof(char*) * capacity * 2);
+            capacity *= 2;
+        }
+        names[count++] = parser_token_text(parser);
+        parser_advance(parser);
+    }
+    ASTNode* node = ast_create_node(parser->arena, AST_PARALLEL_RUN_STATEMENT);
+    node->data.parallel_run_statement.category_names = names;
+    node->data.parallel_run_statement.slots = arena_alloc(parser->arena, sizeof(int) * count);
+    node->data.parallel_run_statement.count = count;
+    return node;
+}
+
+// call 言語 "コード"。文（出力を書く）でも式（出力を値にする）でも同じ形
+ASTNode* parse_call(Parser* parser, ASTNodeType type) {
     if (!parser_expect(parser, TOKEN_CALL)) return NULL;
     if (parser->current_token.type != TOKEN_PY && parser->current_token.type != TOKEN_IDENTIFIER) {
-        printf("Parse error: Expected language identifier for call statement\n");
+        output_error(&parser->errors, "Parse error: Expected language identifier for call statement\n");
         return NULL;
     }
-    char* language = strdup(parser->current_token.value);
+    char* language = parser_token_text(parser);
     parser_advance(parser);
-    ASTNode* code_expr = parse_expression(parser);
+    ASTNode* code_expr = parse_primary(parser);
     if (!code_expr || code_expr->type != AST_STRING) {
-        printf("Parse error: Expected string expression (code) for call statement\n");
-        free(language);
-        ast_free(code_expr);
+        output_error(&parser->errors, "Parse error: Expected string expression (code) for call statement\n");
         return NULL;
     }
-    ASTNode* node = ast_create_node(AST_CALL_STATEMENT);
+    ASTNode* node = ast_create_node(parser->arena, type);
     node->data.call_statement.language = language;
-    node->data.call_statement.code = code_expr->data.string.value;
-    code_expr->data.string.value = NULL;
-    ast_free(code_expr);
+    node->data.call_statement.code = code_expr->data.string.value->chars;
     return node;
 }
 
+ASTNode* parse_call_statement(Parser* parser) {
+    return parse_call(parser, AST_CALL_STATEMENT);
+}
+
 ASTNode* parse_category_definition(Parser* parser) {
     if (!parser_expect(parser, TOKEN_FUNC)) return NULL;
     if (parser->current_token.type != TOKEN_IDENTIFIER) {
-        printf("Parse error: Expected category name after 'func'\n");
+        output_error(&parser->errors, "Parse error: Expected category name after 'func'\n");
         return NULL;
     }
-    char* name = strdup(parser->current_token.value);
+    char* name = parser_token_text(parser);
     parser_advance(parser);
-    if (!parser_expect(parser, TOKEN_LPAREN)) { free(name); return NULL;}
-    if (!parser_expect(parser, TOKEN_RPAREN)) { free(name); return NULL;}
-    ASTNode** statements = malloc(sizeof(ASTNode*) * 10);
-    int count = 0, capacity = 10;
+    if (!parser_expect(parser, TOKEN_LPAREN)) return NULL;
+    if (!parser_expect(parser, TOKEN_RPAREN)) return NULL;
+    int count = 0, capacity = 16;
+    ASTNode** statements = arena_alloc(parser->arena, sizeof(ASTNode*) * capacity);
     while (parser->current_token.type != TOKEN_BLOCK_END && parser->current_token.type != TOKEN_EOF) {
+        if (parser->current_token.type == TOKEN_CMD_END) { parser_advance(parser); continue; }
         ASTNode* stmt = parse_statement(parser);
         if (stmt) {
             if (count >= capacity) {
+                statements = arena_grow(parser->arena, statements, sizeof(ASTNode*) * capacity, sizeof(ASTNode*) * capacity * 2);
                 capacity *= 2;
-                statements = realloc(statements, sizeof(ASTNode*) * capacity);
             }
             statements[count++] = stmt;
         } else {
             if (parser->current_token.type == TOKEN_CMD_END) { parser_advance(parser); continue; }
-            for (int i = 0; i < count; i++) ast_free(statements[i]);
-            free(statements); free(name);
             return NULL;
         }
     }
-    if (!parser_expect(parser, TOKEN_BLOCK_END)) {
-        for (int i = 0; i < count; i++) ast_free(statements[i]);
-        free(statements); free(name);
-        return NULL;
-    }
-    ASTNode* node = ast_create_node(AST_CATEGORY_DEFINITION);
+    if (!parser_expect(parser, TOKEN_BLOCK_END)) return NULL;
+    ASTNode* node = ast_create_node(parser->arena, AST_CATEGORY_DEFINITION);
     node->data.category_definition.name = name;
     node->data.category_definition.statements = statements;
     node->data.category_definition.statement_count = count;
+    node->data.category_definition.slot = -1;
     return node;
 }
 
 // --- Top-Level Statement Parsing ---
-ASTNode* parse_statement(Parser* parser) {
+// 式を一度だけ読み、続くトークンが "/ ?" なら if文の条件式として扱う
+ASTNode* parse_expression_statement(Parser* parser) {
+    ASTNode* expression = parse_expression(parser);
+    if (!expression) return NULL;
+    if (parser->current_token.type == TOKEN_CMD_END && parser_peek(parser, 1).type == TOKEN_IF) {
+        parser_advance(parser);
+        parser_advance(parser);
+        return parse_if_statement_after_condition(parser, expression);
+    }
+    return parse_statement_end(parser, expression);
+}
+
+static ASTNode* parse_statement_node(Parser* parser) {
     ASTNode* node = NULL;
     if (parser->current_token.type == TOKEN_FUNC) {
         node = parse_category_definition(parser);
@@ -440,73 +488,123 @@ ASTNode* parse_statement(Parser* parser) {
             node = parse_sunum_statement(parser); break;
         case TOKEN_RUN:
             node = parse_run_statement(parser); break;
+        case TOKEN_PRUN:
+            node = parse_parallel_run_statement(parser); break;
         case TOKEN_CALL:
             node = parse_call_statement(parser); break;
         case TOKEN_IDENTIFIER:
-            if (parser->position + 1 < parser->tokens.count && parser->tokens.tokens[parser->position + 1].type == TOKEN_ASSIGN)
+            if (parser_peek(parser, 1).type == TOKEN_ASSIGN) {
                 node = parse_assignment(parser);
-            else {
-                // if文のショート判定
-                int backup_position = parser->position;
-                Token backup_token = parser->current_token;
-                ASTNode* test_if = parse_if_statement(parser);
-                if (test_if) return test_if;
-                // if文でなければ元に戻して式として扱う
-                parser->position = backup_position;
-                parser->current_token = backup_token;
-                node = parse_expression(parser);
+                break;
             }
-            break;
+            return parse_expression_statement(parser);
         case TOKEN_NUMBER:
+        case TOKEN_STRING:
         case TOKEN_LPAREN:
-            // if文か式
-            {
-                int backup_position = parser->position;
-                Token backup_token = parser->current_token;
-                ASTNode* test_if = parse_if_statement(parser);
-                if (test_if) return test_if;
-                parser->position = backup_position;
-                parser->current_token = backup_token;
-                node = parse_expression(parser);
-            }
-            break;
+        case TOKEN_PLUS:
+        case TOKEN_MINUS:
+        case TOKEN_TILDE:
+            return parse_expression_statement(parser);
         default:
             if (parser->current_token.type == TOKEN_CMD_END) {
                 parser_advance(parser); return NULL;
             }
-            printf("Parse error: Unexpected statement start %s\n", token_to_string(parser->current_token.type));
+            output_error(&parser->errors, "Parse error: Unexpected statement start %s\n", token_to_string(parser->current_token.type));
             return NULL;
     }
     if (node) return parse_statement_end(parser, node);
     return NULL;
 }
 
+// 文の位置はプロファイラが行と桁に直して使う
+ASTNode* parse_statement(Parser* parser) {
+    int offset = parser->current_token.start;
+    ASTNode* node = parse_statement_node(parser);
+    if (node) node->offset = offset;
+    return node;
+}
+
 ASTNode* parse(Parser* parser) {
-    ASTNode** statements = malloc(sizeof(ASTNode*) * 10);
-    int count = 0, capacity = 10;
+    int count = 0, capacity = 16;
+    ASTNode** statements = arena_alloc(parser->arena, sizeof(ASTNode*) * capacity);
     while (parser->current_token.type != TOKEN_EOF) {
+        // 空の文（プログラム終端の "//" など）は読み飛ばす
+        if (parser->current_token.type == TOKEN_CMD_END) { parser_advance(parser); continue; }
         ASTNode* stmt = parse_statement(parser);
         if (stmt) {
             if (count >= capacity) {
+                statements = arena_grow(parser->arena, statements, sizeof(ASTNode*) * capacity, sizeof(ASTNode*) * capacity * 2);
                 capacity *= 2;
-                statements = realloc(statements, sizeof(ASTNode*) * capacity);
             }
             statements[count++] = stmt;
         } else if (parser->current_token.type == TOKEN_EOF) {
             break;
         } else {
-            for (int i = 0; i < count; i++) ast_free(statements[i]);
-            free(statements); return NULL;
+            return NULL;
         }
     }
-    if (count == 0) { free(statements); return NULL;}
-    if (count == 1) {
-        ASTNode* single_node = statements[0];
-        free(statements);
-        return single_node;
-    }
-    ASTNode* compound_node = ast_create_node(AST_COMPOUND_STATEMENT);
+    if (count == 0) return NULL;
+    if (count == 1) return statements[0];
+    ASTNode* compound_node = ast_create_node(parser->arena, AST_COMPOUND_STATEMENT);
     compound_node->data.compound_statement.statements = statements;
     compound_node->data.compound_statement.statement_count = count;
     return compound_node;
-}
\ No newline at end of file
+}
+// --- AST Dump ---
+static void ast_dump_list(FILE* out, ASTNode** statements, int count, int depth) {
+    for (int i = 0; i < count; i++) ast_dump(out, statements[i], depth);
+}
+
+void ast_dump(FILE* out, ASTNode* node, int depth) {
+    fprintf(out, "%*s", depth * 2, "");
+    if (!node) { fprintf(out, "(empty)\n"); return; }
+    switch (node->type) {
+        case AST_NUMBER: fprintf(out, "Number %g\n", node->data.number.value); break;
+        case AST_STRING: fprintf(out, "String \"%s\"\n", node->data.string.value->chars); break;
+        case AST_IDENTIFIER: fprintf(out, "Identifier %s\n", node->data.identifier.name); break;
+        case AST_BINARY_OP:
+            fprintf(out, "BinaryOp %s\n", token_to_string(node->data.binary_op.operator));
+            ast_dump(out, node->data.binary_op.left, depth + 1);
+            ast_dump(out, node->data.binary_op.right, depth + 1);
+            break;
+        case AST_UNARY_OP:
+            fprintf(out, "UnaryOp %s\n", token_to_string(node->data.unary_op.operator));
+            ast_dump(out, node->data.unary_op.operand, depth + 1);
+            break;
+        case AST_ASSIGNMENT:
+        case AST_RE_ASSIGNMENT:
+            fprintf(out, "%s %s\n", node->type == AST_ASSIGNMENT ? "Assignment" : "ReAssignment", node->data.assignment.variable);
+            ast_dump(out, node->data.assignment.expression, depth + 1);
+            break;
+        case AST_SUNUM_STATEMENT: fprintf(out, "Sunum %s\n", node->data.assignment.variable); break;
+        case AST_IF_STATEMENT:
+            fprintf(out, "If\n");
+            ast_dump(out, node->data.if_statement.condition, depth + 1);
+            ast_dump(out, node->data.if_statement.then_stmt, depth + 1);
+            if (node->data.if_statement.else_stmt) ast_dump(out, node->data.if_statement.else_stmt, depth + 1);
+            break;
+        case AST_COMPOUND_STATEMENT:
+            fprintf(out, "Compound (%d)\n", node->data.compound_statement.statement_count);
+            ast_dump_list(out, node->data.compound_statement.statements, node->data.compound_statement.statement_count, depth + 1);
+            break;
+        case AST_CATEGORY_DEFINITION:
+            fprintf(out, "Category %s (%d)\n", node->data.category_definition.name, node->data.category_definition.statement_count);
+            ast_dump_list(out, node->data.category_definition.statements, node->data.category_definition.statement_count, depth + 1);
+            break;
+        case AST_WRITE_STATEMENT:
+            fprintf(out, "Write\n");
+            ast_dump(out, node->data.write_statement.expression, depth + 1);
+            break;
+        case AST_NUM_WRITE_STATEMENT: fprintf(out, "NumWrite %s\n", node->data.num_write_statement.variable_name); break;
+        case AST_RUN_STATEMENT: fprintf(out, "Run %s\n", node->data.run_statement.category_name); break;
+        case AST_PARALLEL_RUN_STATEMENT:
+            fprintf(out, "ParallelRun");
+            for (int i = 0; i < node->data.parallel_run_statement.count; i++)
+                fprintf(out, " %s", node->data.parallel_run_statement.category_names[i]);
+            fprintf(out, "\n");
+            break;
+        case AST_CALL_EXPRESSION: fprintf(out, "CallValue %s \"%s\"\n", node->data.call_statement.language, node->data.call_statement.code); break;
+        case AST_CALL_STATEMENT: fprintf(out, "Call %s \"%s\"\n", node->data.call_statement.language, node->data.call_statement.code); break;
+        default: fprintf(out, "Node %d\n", node->type); break;
+    }
+}
@@ -2,6 +2,8 @@
 #define PARSER_H
 
 #include "lexer.h"
+#include "rstring.h"
+#include "output.h"
 
 // ASTノードタイプ
 typedef enum {
@@ -10,6 +12,7 @@ typedef enum {
     AST_IDENTIFIER,
     AST_BINARY_OP,
     AST_UNARY_OP,
+    AST_CALL_EXPRESSION,    // x = call py "..."（出力を値にする。data は call_statement）
     AST_ASSIGNMENT,
     AST_RE_ASSIGNMENT,
     AST_SUNUM_STATEMENT,
@@ -20,16 +23,18 @@ typedef enum {
     AST_NUM_WRITE_STATEMENT,
     AST_RUN_STATEMENT,
     AST_CALL_STATEMENT,
-    AST_CATEGORY_DEFINITION
+    AST_CATEGORY_DEFINITION,
+    AST_PARALLEL_RUN_STATEMENT
 } ASTNodeType;
 
 // ASTノード構造体
 typedef struct ASTNode {
     ASTNodeType type;
+    int offset;     // 文の先頭トークンのソース上の位置（文でないノードは -1）
     union {
         struct { double value; } number;
-        struct { char* value; } string;
-        struct { char* name; } identifier;
+        struct { RString* value; } string;   // アリーナの解放時に参照を手放す
+        struct { char* name; int slot; } identifier;
         struct {
             TokenType operator;
             struct ASTNode* left;
@@ -42,8 +47,9 @@ typedef struct ASTNode {
         struct {
             char* variable;
             struct ASTNode* expression;
+            int slot;
         } assignment;
-        struct { char* variable_name; } num_write_statement;
+        struct { char* variable_name; int slot; } num_write_statement;
         struct {
             struct ASTNode* condition;
             struct ASTNode* then_stmt;
@@ -57,6 +63,7 @@ typedef struct ASTNode {
             char* name;
             struct ASTNode** statements;
             int statement_count;
+            int slot;
         } category_definition;
         struct {
             char* function_name;
@@ -64,26 +71,42 @@ typedef struct ASTNode {
             int arg_count;
         } function_call;
         struct { struct ASTNode* expression; } write_statement;
-        struct { char* category_name; } run_statement;
+        struct { char* category_name; int slot; } run_statement;
+        struct { char** category_names; int* slots; int count; } parallel_run_statement;
         struct { char* language; char* code; } call_statement;
     } data;
 } ASTNode;
 
+// 先読みリングバッファの大きさ
+#define PARSER_LOOKAHEAD 4
+
+// パーサは字句解析器からトークンを逐次引き出すので、トークン列全体を持たない。
+// ポインタ以外はすべて値なので、構造体のコピーで状態を退避・復元できる
 typedef struct {
-    TokenList tokens;
-    int position;
+    Lexer lexer;
+    int lexer_done;     // EOF か ERROR を読んだ
+    Token lookahead[PARSER_LOOKAHEAD];
+    int lookahead_start;
+    int lookahead_count;
     Token current_token;
+    const char* source; // トークンが指すソースバッファ
+    Arena* arena;       // ASTノードの割り当て先
+    Allocator* allocator;   // パーサ自身と文字列リテラルの割り当て先
+    OutputSink errors;      // 構文エラーの出力先（既定は stdio の stdout）
 } Parser;
 
 // 関数宣言
-Parser* parser_create(TokenList tokens);
+// ASTはパーサのアリーナ上に作られ、arena_reset() でまとめて解放される
+Parser* parser_create(const char* source, int length, Arena* arena, Allocator* allocator);
 void parser_free(Parser* parser);
 ASTNode* parse(Parser* parser);
-void ast_free(ASTNode* node);
 
 void parser_advance(Parser* parser);
+Token parser_peek(Parser* parser, int n);
 int parser_expect(Parser* parser, TokenType expected);
-ASTNode* ast_create_node(ASTNodeType type);
+ASTNode* ast_create_node(Arena* arena, ASTNodeType type);
+ASTNode* ast_create_string_node(Arena* arena, RString* string);
+void ast_dump(FILE* out, ASTNode* node, int depth);
 ASTNode* parse_primary(Parser* parser);
 ASTNode* parse_term(Parser* parser);
 ASTNode* parse_expression(Parser* parser);
@@ -95,8 +118,11 @@ ASTNode* parse_assignment(Parser* parser);
 ASTNode* parse_re_assignment_statement(Parser* parser);
 ASTNode* parse_sunum_statement(Parser* parser);
 ASTNode* parse_run_statement(Parser* parser);
+ASTNode* parse_parallel_run_statement(Parser* parser);
 ASTNode* parse_call_statement(Parser* parser);
+ASTNode* parse_call(Parser* parser, ASTNodeType type);
 ASTNode* parse_statement(Parser* parser);
+ASTNode* parse_expression_statement(Parser* parser);
 ASTNode* parse_if_statement(Parser* parser);
 ASTNode* parse_if_statement_after_condition(Parser* parser, ASTNode* condition);
 ASTNode* parse_category_definition(Parser* parser);
@@ -0,0 +1,301 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "profile.h"
+
+// x86 ではタイムスタンプカウンタを読み、レポート時に経過時間で換算する
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <x86intrin.h>
+static inline uint64_t profile_ticks(void) { return __rdtsc(); }
+#else
+static inline uint64_t profile_ticks(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+#endif
+
+static double profile_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void* checked_realloc(void* ptr, size_t size) {
+    void* grown = realloc(ptr, size);
+    if (!grown) { perror("realloc failed"); exit(EXIT_FAILURE); }
+    return grown;
+}
+
+static unsigned hash_int(unsigned key) {
+    key ^= key >> 16;
+    key *= 0x45d9f3bu;
+    key ^= key >> 16;
+    return key;
+}
+
+Profile* profile_create(void) {
+    Profile* profile = calloc(1, sizeof(Profile));
+    if (!profile) { perror("calloc failed"); exit(EXIT_FAILURE); }
+    profile->frame_capacity = 16;
+    profile->frames = checked_realloc(NULL, sizeof(ProfileFrame) * profile->frame_capacity);
+    profile->frames[0] = (ProfileFrame){ -1, -1, 0 };
+    profile->frame_count = 1;
+    profile->charged_statement = -1;
+    profile_start(profile);
+    return profile;
+}
+
+void profile_start(Profile* profile) {
+    profile->start_seconds = profile_seconds();
+    profile->start_tick = profile->last_tick = profile_ticks();
+}
+
+void profile_free(Profile* profile) {
+    if (!profile) return;
+    free(profile->statements);
+    free(profile->statement_buckets);
+    free(profile->frames);
+    free(profile->frame_buckets);
+    free(profile);
+}
+
+// --- Statements ---
+static unsigned statement_hash(int offset) { return hash_int((unsigned)offset); }
+
+static void statement_rehash(Profile* profile) {
+    int count = profile->statement_bucket_count ? profile->statement_bucket_count * 2 : 64;
+    int* buckets = calloc((size_t)count, sizeof(int));
+    if (!buckets) { perror("calloc failed"); exit(EXIT_FAILURE); }
+    for (int i = 0; i < profile->statement_count; i++) {
+        unsigned h = statement_hash(profile->statements[i].offset) & (unsigned)(count - 1);
+        while (buckets[h]) h = (h + 1) & (unsigned)(count - 1);
+        buckets[h] = i + 1;
+    }
+    free(profile->statement_buckets);
+    profile->statement_buckets = buckets;
+    profile->statement_bucket_count = count;
+}
+
+int profile_statement_id(Profile* profile, int offset) {
+    if (profile->statement_count * 2 >= profile->statement_bucket_count) statement_rehash(profile);
+    unsigned mask = (unsigned)(profile->statement_bucket_count - 1);
+    unsigned h = statement_hash(offset) & mask;
+    while (profile->statement_buckets[h]) {
+        int id = profile->statement_buckets[h] - 1;
+        if (profile->statements[id].offset == offset) return id;
+        h = (h + 1) & mask;
+    }
+    if (profile->statement_count >= profile->statement_capacity) {
+        profile->statement_capacity = profile->statement_capacity ? profile->statement_capacity * 2 : 64;
+        profile->statements = checked_realloc(profile->statements, sizeof(ProfileStatement) * profile->statement_capacity);
+    }
+    int id = profile->statement_count++;
+    profile->statements[id] = (ProfileStatement){ offset, 0, 0 };
+    profile->statement_buckets[h] = id + 1;
+    return id;
+}
+
+// 前回の文の開始からの時間を、その文とその時点の呼び出し文脈へ加算する
+static void profile_charge(Profile* profile, uint64_t now) {
+    uint64_t elapsed = now - profile->last_tick;
+    if (profile->charged_statement >= 0) profile->statements[profile->charged_statement].ticks += elapsed;
+    profile->frames[profile->charged_frame].ticks += elapsed;
+    profile->last_tick = now;
+}
+
+void profile_statement(Profile* profile, int id) {
+    profile_charge(profile, profile_ticks());
+    profile->charged_statement = id;
+    profile->charged_frame = profile->current_frame;
+    profile->statements[id].count++;
+}
+
+// --- Call Frames ---
+static unsigned frame_hash(int parent, int category) {
+    return hash_int((unsigned)parent * 0x9e3779b1u ^ (unsigned)category);
+}
+
+static void frame_rehash(Profile* profile) {
+    int count = profile->frame_bucket_count ? profile->frame_bucket_count * 2 : 64;
+    int* buckets = calloc((size_t)count, sizeof(int));
+    if (!buckets) { perror("calloc failed"); exit(EXIT_FAILURE); }
+    for (int i = 1; i < profile->frame_count; i++) {
+        unsigned h = frame_hash(profile->frames[i].parent, profile->frames[i].category) & (unsigned)(count - 1);
+        while (buckets[h]) h = (h + 1) & (unsigned)(count - 1);
+        buckets[h] = i + 1;
+    }
+    free(profile->frame_buckets);
+    profile->frame_buckets = buckets;
+    profile->frame_bucket_count = count;
+}
+
+// (parent, category) の文脈を探し、なければ作る
+static int frame_index(Profile* profile, int parent, int category) {
+    if (profile->frame_count * 2 >= profile->frame_bucket_count) frame_rehash(profile);
+    unsigned mask = (unsigned)(profile->frame_bucket_count - 1);
+    unsigned h = frame_hash(parent, category) & mask;
+    while (profile->frame_buckets[h]) {
+        int index = profile->frame_buckets[h] - 1;
+        if (profile->frames[index].parent == parent && profile->frames[index].category == category) return index;
+        h = (h + 1) & mask;
+    }
+    if (profile->frame_count >= profile->frame_capacity) {
+        profile->frame_capacity *= 2;
+        profile->frames = checked_realloc(profile->frames, sizeof(ProfileFrame) * profile->frame_capacity);
+    }
+    int index = profile->frame_count++;
+    profile->frames[index] = (ProfileFrame){ category, parent, 0 };
+    profile->frame_buckets[h] = index + 1;
+    return index;
+}
+
+void profile_enter(Profile* profile, int category) {
+    profile->current_frame = frame_index(profile, profile->current_frame, category);
+}
+
+void profile_leave(Profile* profile) {
+    if (profile->current_frame > 0) profile->current_frame = profile->frames[profile->current_frame].parent;
+}
+
+void profile_stop(Profile* profile) {
+    profile_charge(profile, profile_ticks());
+    profile->charged_statement = -1;
+}
+
+// --- Workers ---
+static void* copy_array(const void* data, size_t size) {
+    void* copy = checked_realloc(NULL, size ? size : 1);
+    if (size) memcpy(copy, data, size);
+    return copy;
+}
+
+Profile* profile_create_worker(const Profile* parent) {
+    Profile* profile = calloc(1, sizeof(Profile));
+    if (!profile) { perror("calloc failed"); exit(EXIT_FAILURE); }
+    // 文の番号はコンパイル済みの OP_STMT と同じものを使う
+    profile->statement_count = profile->statement_capacity = parent->statement_count;
+    profile->statements = copy_array(parent->statements, sizeof(ProfileStatement) * (size_t)parent->statement_count);
+    for (int i = 0; i < profile->statement_count; i++) profile->statements[i].count = profile->statements[i].ticks = 0;
+    profile->statement_bucket_count = parent->statement_bucket_count;
+    profile->statement_buckets = parent->statement_buckets
+        ? copy_array(parent->statement_buckets, sizeof(int) * (size_t)parent->statement_bucket_count) : NULL;
+    profile->frame_count = profile->frame_capacity = parent->frame_count;
+    profile->frames = copy_array(parent->frames, sizeof(ProfileFrame) * (size_t)parent->frame_count);
+    for (int i = 0; i < profile->frame_count; i++) profile->frames[i].ticks = 0;
+    profile->frame_bucket_count = parent->frame_bucket_count;
+    profile->frame_buckets = parent->frame_buckets
+        ? copy_array(parent->frame_buckets, sizeof(int) * (size_t)parent->frame_bucket_count) : NULL;
+    profile->current_frame = profile->charged_frame = parent->current_frame;
+    profile->charged_statement = -1;
+    profile_start(profile);
+    return profile;
+}
+
+void profile_merge(Profile* profile, const Profile* worker) {
+    for (int i = 0; i < worker->statement_count; i++) {
+        const ProfileStatement* statement = &worker->statements[i];
+        if (!statement->count && !statement->ticks) continue;
+        int id = profile_statement_id(profile, statement->offset);
+        profile->statements[id].count += statement->count;
+        profile->statements[id].ticks += statement->ticks;
+    }
+    // 文脈の親は必ず前に並ぶので、先頭から順に親側の添字へ置き換えられる
+    int* indices = checked_realloc(NULL, sizeof(int) * (size_t)worker->frame_count);
+    indices[0] = 0;
+    profile->frames[0].ticks += worker->frames[0].ticks;
+    for (int i = 1; i < worker->frame_count; i++) {
+        const ProfileFrame* frame = &worker->frames[i];
+        indices[i] = frame_index(profile, indices[frame->parent], frame->category);
+        profile->frames[indices[i]].ticks += frame->ticks;
+    }
+    free(indices);
+}
+
+// --- Report ---
+// 並べ替えは文へのポインタの配列で行う（比較関数に大域の表を渡さない）
+static int compare_offsets(const void* a, const void* b) {
+    return (*(const ProfileStatement* const*)a)->offset - (*(const ProfileStatement* const*)b)->offset;
+}
+
+static int compare_ticks(const void* a, const void* b) {
+    uint64_t x = (*(const ProfileStatement* const*)a)->ticks, y = (*(const ProfileStatement* const*)b)->ticks;
+    return x < y ? 1 : x > y ? -1 : 0;
+}
+
+static void write_frame_path(const Profile* profile, int index, const SymbolTable* categories, FILE* folded) {
+    int depth = 0;
+    for (int frame = index; frame > 0; frame = profile->frames[frame].parent) depth++;
+    int* path = malloc(sizeof(int) * (depth ? depth : 1));
+    for (int frame = index, i = depth; frame > 0; frame = profile->frames[frame].parent) path[--i] = frame;
+    fputs("main", folded);
+    for (int i = 0; i < depth; i++) {
+        int category = profile->frames[path[i]].category;
+        fprintf(folded, ";%s", category < categories->count ? categories->names[category] : "?");
+    }
+    free(path);
+}
+
+void profile_report(Profile* profile, const char* source, size_t length, const SymbolTable* categories,
+                    FILE* report, FILE* folded) {
+    profile_stop(profile);
+    uint64_t total_ticks = profile->last_tick - profile->start_tick;
+    double total_seconds = profile_seconds() - profile->start_seconds;
+    double seconds_per_tick = total_ticks ? total_seconds / (double)total_ticks : 0;
+
+    if (report) {
+        int count = profile->statement_count;
+        const ProfileStatement** order = malloc(sizeof(ProfileStatement*) * (count ? count : 1));
+        int* lines = malloc(sizeof(int) * (count ? count : 1));
+        int* columns = malloc(sizeof(int) * (count ? count : 1));
+        for (int i = 0; i < count; i++) order[i] = &profile->statements[i];
+        // 位置順に並べてソースを1回だけ走査し、行と桁を求める
+        qsort(order, (size_t)count, sizeof(*order), compare_offsets);
+        int line = 1, column = 1;
+        size_t position = 0;
+        for (int i = 0; i < count; i++) {
+            int index = (int)(order[i] - profile->statements);
+            if (order[i]->offset < 0) { lines[index] = columns[index] = 0; continue; }
+            size_t offset = (size_t)order[i]->offset;
+            for (; position < offset && position < length; position++) {
+                if (source[position] == '\n') { line++; column = 1; }
+                else column++;
+            }
+            lines[index] = line;
+            columns[index] = column;
+        }
+        qsort(order, (size_t)count, sizeof(*order), compare_ticks);
+
+        fprintf(report, "Profile: %.3f ms total\n", total_seconds * 1e3);
+        fprintf(report, "  %-10s %12s %12s %7s  %s\n", "line:col", "count", "ms", "%", "statement");
+        for (int i = 0; i < count; i++) {
+            const ProfileStatement* statement = order[i];
+            if (!statement->count) continue;
+            int index = (int)(statement - profile->statements);
+            char position_text[32];
+            snprintf(position_text, sizeof(position_text), "%d:%d", lines[index], columns[index]);
+            // 文の先頭から行末まで（長ければ切り詰める）
+            int text_length = 0;
+            while (statement->offset >= 0 && (size_t)(statement->offset + text_length) < length && text_length < 48 &&
+                   source[statement->offset + text_length] != '\n' && source[statement->offset + text_length] != '\r')
+                text_length++;
+            fprintf(report, "  %-10s %12lld %12.3f %6.1f%%  %.*s\n", position_text, statement->count,
+                    statement->ticks * seconds_per_tick * 1e3,
+                    total_ticks ? 100.0 * (double)statement->ticks / (double)total_ticks : 0.0,
+                    text_length, statement->offset >= 0 ? source + statement->offset : "");
+        }
+        free(order);
+        free(lines);
+        free(columns);
+    }
+
+    if (folded) {
+        for (int i = 0; i < profile->frame_count; i++) {
+            long long micros = (long long)(profile->frames[i].ticks * seconds_per_tick * 1e6 + 0.5);
+            if (micros <= 0) continue;
+            write_frame_path(profile, i, categories, folded);
+            fprintf(folded, " %lld\n", micros);
+        }
+    }
+}
@@ -0,0 +1,63 @@
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include "symbols.h"
+
+// 文単位のプロファイラ（--profile）。文の開始ごとに時刻を読み、直前の文とその時点の
+// カテゴリ呼び出し文脈へ経過時間を加算する（各文の時間は次の文が始まるまでの時間）
+typedef struct {
+    int offset;         // 文の先頭トークンのソース上の位置
+    long long count;
+    uint64_t ticks;
+} ProfileStatement;
+
+// 呼び出し文脈木のノード。根（frames[0]）はトップレベル
+typedef struct {
+    int category;       // カテゴリスロット（根は -1）
+    int parent;
+    uint64_t ticks;     // この文脈で直接使った時間
+} ProfileFrame;
+
+typedef struct Profile {
+    ProfileStatement* statements;
+    int statement_count;
+    int statement_capacity;
+    int* statement_buckets;     // offset -> 添字+1（オープンアドレス法、0 は空き）
+    int statement_bucket_count;
+    ProfileFrame* frames;
+    int frame_count;
+    int frame_capacity;
+    int* frame_buckets;         // (親, カテゴリ) -> 添字+1
+    int frame_bucket_count;
+    int current_frame;
+    int charged_statement;      // 次に時間を加算する文（-1 = なし）
+    int charged_frame;
+    uint64_t last_tick;
+    uint64_t start_tick;
+    double start_seconds;
+} Profile;
+
+Profile* profile_create(void);
+void profile_free(Profile* profile);
+void profile_start(Profile* profile);   // 実行の直前に呼ぶ（コンパイルなどの時間を含めない）
+
+// 文の番号（コンパイル時に OP_STMT へ埋め込む）
+int profile_statement_id(Profile* profile, int offset);
+void profile_statement(Profile* profile, int id);
+void profile_enter(Profile* profile, int category);
+void profile_leave(Profile* profile);
+void profile_stop(Profile* profile);    // 最後の文の時間を加算する
+
+// prun のタスク用。文の番号と呼び出し文脈を親から写し、親の現在の文脈から計測を始める。
+// 合流後に profile_merge で回数と時間を親へ足す（親はタスクの実行中に触らない）
+Profile* profile_create_worker(const Profile* parent);
+void profile_merge(Profile* profile, const Profile* worker);
+
+// 文ごとの回数と時間を report へ、カテゴリ呼び出し文脈ごとの時間（マイクロ秒）を
+// flamegraph.pl などが読める folded 形式で folded へ書き出す（どちらも NULL 可）
+void profile_report(Profile* profile, const char* source, size_t length, const SymbolTable* categories,
+                    FILE* report, FILE* folded);
+
+#endif
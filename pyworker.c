@@ -0,0 +1,274 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include "pyworker.h"
+#include "parallel.h"
+
+#define MAX_POOL_SIZE 256
+
+static int requested_size = 0;
+
+void pyworker_set_pool_size(int size) {
+    requested_size = size;
+}
+
+void pyworker_result_free(PyWorkerResult* result) {
+    free(result->output);
+    free(result->errors);
+    result->output = result->errors = NULL;
+    result->output_length = result->errors_length = 0;
+}
+
+// 失敗の理由を errors に入れる
+static PyWorkerStatus fail(PyWorkerResult* result, const char* format, ...) {
+    char message[256];
+    va_list args;
+    va_start(args, format);
+    vsnprintf(message, sizeof(message), format, args);
+    va_end(args);
+    free(result->errors);
+    result->errors_length = strlen(message);
+    result->errors = malloc(result->errors_length + 1);
+    if (!result->errors) { perror("malloc failed"); exit(EXIT_FAILURE); }
+    memcpy(result->errors, message, result->errors_length + 1);
+    return PYWORKER_FAILED;
+}
+
+#ifdef _WIN32
+// 子プロセスとソケットの組み合わせは POSIX でのみ用意する
+PyWorkerStatus pyworker_call(const char* code, size_t length, PyWorkerResult* result) {
+    (void)code; (void)length;
+    memset(result, 0, sizeof(*result));
+    return fail(result, "Python workers are not supported on this platform");
+}
+#else
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <spawn.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0  // macOS は SO_NOSIGPIPE で止める
+#endif
+
+extern char** environ;
+
+// ワーカーの本体（python3 -c）。プロトコルは要求 [u32 長さ][コード]、
+// 応答 [u8 'o' か 'e'][u32 出力の長さ][u32 エラーの長さ][出力][エラー]（長さはビッグエンディアン）。
+// ソケットは別の fd に移し、fd 0 は /dev/null、fd 1 は標準エラー出力にして、ユーザーのコードが触れないようにする。
+// 名前空間は呼び出しごとに新しく作る（import したモジュールはプロセスに残るので2回目からは速い）
+static const char* bootstrap =
+    "import io, os, struct, sys, traceback\n"
+    "conn = os.dup(0)\n"
+    "reply = os.fdopen(os.dup(1), 'wb')\n"
+    "os.dup2(os.open(os.devnull, os.O_RDONLY), 0)\n"
+    "os.dup2(2, 1)\n"
+    "def read(n):\n"
+    "    data = bytearray()\n"
+    "    while len(data) < n:\n"
+    "        chunk = os.read(conn, n - len(data))\n"
+    "        if not chunk: sys.exit(0)\n"
+    "        data += chunk\n"
+    "    return bytes(data)\n"
+    "while True:\n"
+    "    length, = struct.unpack('>I', read(4))\n"
+    "    code = read(length).decode('utf-8', 'replace')\n"
+    "    sys.stdout, sys.stderr = io.StringIO(), io.StringIO()\n"
+    "    status = b'o'\n"
+    "    try:\n"
+    "        exec(compile(code, '<call py>', 'exec'), {'__name__': '__main__'})\n"
+    "    except BaseException as error:\n"
+    "        status = b'e'\n"
+    "        traceback.print_exception(type(error), error, error.__traceback__.tb_next)\n"
+    "    out = sys.stdout.getvalue().encode('utf-8', 'replace')\n"
+    "    err = sys.stderr.getvalue().encode('utf-8', 'replace')\n"
+    "    sys.stdout, sys.stderr = sys.__stdout__, sys.__stderr__\n"
+    "    reply.write(status + struct.pack('>II', len(out), len(err)) + out + err)\n"
+    "    reply.flush()\n";
+
+typedef struct {
+    pid_t pid;      // 0 = 起動していない（未使用か、落ちて起動し直す）
+    int fd;         // ソケットの親側
+    int busy;
+} PyWorker;
+
+// ワーカーは呼び出しが空きを見つけられなかったときに1つずつ起動し、プロセスの終了まで待機させる。
+// 起動・終了の処理は busy を立てたスレッドだけが行う
+static struct {
+    pthread_once_t once;
+    pthread_mutex_t lock;
+    pthread_cond_t idle;
+    PyWorker* workers;
+    int size;
+} pool = { PTHREAD_ONCE_INIT };
+
+static void pool_init(void) {
+    pthread_mutex_init(&pool.lock, NULL);
+    pthread_cond_init(&pool.idle, NULL);
+    long size = requested_size;
+    if (size <= 0) {
+        const char* env = getenv("STRINGS_PY_WORKERS");
+        size = env && *env ? strtol(env, NULL, 10) : 0;
+    }
+    if (size <= 0) size = parallel_default_threads();
+    if (size > MAX_POOL_SIZE) size = MAX_POOL_SIZE;
+    pool.size = (int)size;
+    pool.workers = calloc((size_t)pool.size, sizeof(PyWorker));
+    if (!pool.workers) { perror("malloc failed"); exit(EXIT_FAILURE); }
+}
+
+// 起動済みの空きを優先し、なければ未起動の枠を取る。どちらもなければ待つ
+static PyWorker* acquire_worker(void) {
+    pthread_once(&pool.once, pool_init);
+    pthread_mutex_lock(&pool.lock);
+    PyWorker* chosen = NULL;
+    while (!chosen) {
+        PyWorker* stopped = NULL;
+        for (int i = 0; i < pool.size && !chosen; i++) {
+            PyWorker* worker = &pool.workers[i];
+            if (worker->busy) continue;
+            if (worker->pid) chosen = worker;
+            else if (!stopped) stopped = worker;
+        }
+        if (!chosen) chosen = stopped;
+        if (!chosen) pthread_cond_wait(&pool.idle, &pool.lock);
+    }
+    chosen->busy = 1;
+    pthread_mutex_unlock(&pool.lock);
+    return chosen;
+}
+
+static void release_worker(PyWorker* worker) {
+    pthread_mutex_lock(&pool.lock);
+    worker->busy = 0;
+    pthread_cond_signal(&pool.idle);
+    pthread_mutex_unlock(&pool.lock);
+}
+
+// --- Process ---
+static int spawn_worker(PyWorker* worker, PyWorkerResult* result) {
+    int fds[2];
+#ifdef SOCK_CLOEXEC
+    int failed = socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, fds);
+#else
+    int failed = socketpair(AF_UNIX, SOCK_STREAM, 0, fds);
+    if (!failed) { fcntl(fds[0], F_SETFD, FD_CLOEXEC); fcntl(fds[1], F_SETFD, FD_CLOEXEC); }
+#endif
+    if (failed) {
+        fail(result, "Cannot create a socket for the Python worker: %s", strerror(errno));
+        return 0;
+    }
+#ifdef SO_NOSIGPIPE
+    int on = 1;
+    setsockopt(fds[0], SOL_SOCKET, SO_NOSIGPIPE, &on, sizeof(on));
+#endif
+    const char* python = getenv("STRINGS_PYTHON");
+    if (!python || !*python) python = "python3";
+    char* argv[] = { (char*)python, "-c", (char*)bootstrap, NULL };
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_adddup2(&actions, fds[1], 0);
+    posix_spawn_file_actions_adddup2(&actions, fds[1], 1);
+    pid_t pid;
+    int error = posix_spawnp(&pid, python, &actions, NULL, argv, environ);
+    posix_spawn_file_actions_destroy(&actions);
+    close(fds[1]);
+    if (error) {
+        close(fds[0]);
+        fail(result, "Cannot start %s: %s", python, strerror(error));
+        return 0;
+    }
+    worker->pid = pid;
+    worker->fd = fds[0];
+    return 1;
+}
+
+// 応答が途中で切れた。ソケットを閉じてプロセスを回収し、次に使うときに起動し直す
+static PyWorkerStatus worker_lost(PyWorker* worker, PyWorkerResult* result, int stuck) {
+    pyworker_result_free(result);
+    close(worker->fd);
+    if (stuck) kill(worker->pid, SIGKILL);
+    int status = 0;
+    pid_t pid = worker->pid;
+    worker->pid = 0;
+    while (waitpid(pid, &status, 0) < 0) {
+        if (errno != EINTR) return fail(result, "Python worker %d exited", (int)pid);
+    }
+    if (WIFSIGNALED(status)) return fail(result, "Python worker %d was killed by signal %d", (int)pid, WTERMSIG(status));
+    return fail(result, "Python worker %d exited with status %d", (int)pid, WEXITSTATUS(status));
+}
+
+static int send_all(int fd, const void* data, size_t length) {
+    const char* p = data;
+    while (length > 0) {
+        ssize_t n = send(fd, p, length, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return 0;
+        }
+        p += n;
+        length -= (size_t)n;
+    }
+    return 1;
+}
+
+static int receive_all(int fd, void* data, size_t length) {
+    char* p = data;
+    while (length > 0) {
+        ssize_t n = recv(fd, p, length, 0);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return 0;
+        p += n;
+        length -= (size_t)n;
+    }
+    return 1;
+}
+
+static void put_u32(unsigned char* p, uint32_t value) {
+    p[0] = (unsigned char)(value >> 24); p[1] = (unsigned char)(value >> 16);
+    p[2] = (unsigned char)(value >> 8); p[3] = (unsigned char)value;
+}
+
+static uint32_t get_u32(const unsigned char* p) {
+    return (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 8 | p[3];
+}
+
+// NUL終端つきで length バイトを受け取る
+static char* receive_text(int fd, size_t length) {
+    char* text = malloc(length + 1);
+    if (!text) { perror("malloc failed"); exit(EXIT_FAILURE); }
+    if (!receive_all(fd, text, length)) { free(text); return NULL; }
+    text[length] = '\0';
+    return text;
+}
+
+static PyWorkerStatus exchange(PyWorker* worker, const char* code, size_t length, PyWorkerResult* result) {
+    unsigned char header[9];
+    put_u32(header, (uint32_t)length);
+    if (!send_all(worker->fd, header, 4) || !send_all(worker->fd, code, length) || !receive_all(worker->fd, header, 9))
+        return worker_lost(worker, result, 0);
+    if (header[0] != 'o' && header[0] != 'e') return worker_lost(worker, result, 1);
+    result->output_length = get_u32(header + 1);
+    result->errors_length = get_u32(header + 5);
+    if (!(result->output = receive_text(worker->fd, result->output_length))
+        || !(result->errors = receive_text(worker->fd, result->errors_length)))
+        return worker_lost(worker, result, 0);
+    return header[0] == 'o' ? PYWORKER_OK : PYWORKER_EXCEPTION;
+}
+
+PyWorkerStatus pyworker_call(const char* code, size_t length, PyWorkerResult* result) {
+    memset(result, 0, sizeof(*result));
+    if (length > UINT32_MAX) return fail(result, "Python code is too large");
+    PyWorker* worker = acquire_worker();
+    PyWorkerStatus status = worker->pid || spawn_worker(worker, result)
+                          ? exchange(worker, code, length, result) : PYWORKER_FAILED;
+    release_worker(worker);
+    return status;
+}
+#endif
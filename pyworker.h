@@ -0,0 +1,29 @@
+#ifndef PYWORKER_H
+#define PYWORKER_H
+
+#include <stddef.h>
+
+// call py: 常駐する python3 プロセスのプール。ワーカーは最初に使うときに起動し、
+// 長さ付きのフレームでコードを送って、捕えた標準出力と標準エラー出力を受け取る。
+// ワーカーが落ちたらその呼び出しは失敗にし、次に使うときに起動し直す
+typedef enum {
+    PYWORKER_OK,
+    PYWORKER_EXCEPTION,     // コードが例外を投げた（errors にトレースバック）
+    PYWORKER_FAILED         // ワーカーを起動できない・途中で終了した（errors に理由）
+} PyWorkerStatus;
+
+typedef struct {
+    char* output;           // Python の標準出力（malloc、NUL終端）
+    size_t output_length;
+    char* errors;           // 標準エラー出力・トレースバック・失敗の理由（malloc、NUL終端）
+    size_t errors_length;
+} PyWorkerResult;
+
+// code を空いているワーカーで実行する。空きがなければ待つ。どのスレッドからも呼べる
+PyWorkerStatus pyworker_call(const char* code, size_t length, PyWorkerResult* result);
+void pyworker_result_free(PyWorkerResult* result);
+
+// プールの大きさ。最初の call py より前に呼ぶ（0 = STRINGS_PY_WORKERS、なければ parallel_default_threads()）
+void pyworker_set_pool_size(int size);
+
+#endif
@@ -0,0 +1,60 @@
+#include "resolver.h"
+
+void resolve_names(Interpreter* interpreter, ASTNode* node) {
+    if (!node) return;
+    switch (node->type) {
+        case AST_NUMBER:
+        case AST_STRING:
+        case AST_CALL_STATEMENT:
+        case AST_CALL_EXPRESSION:
+            break;
+        case AST_RUN_STATEMENT:
+            node->data.run_statement.slot = interpreter_intern_category(interpreter, node->data.run_statement.category_name);
+            break;
+        case AST_PARALLEL_RUN_STATEMENT:
+            for (int i = 0; i < node->data.parallel_run_statement.count; i++)
+                node->data.parallel_run_statement.slots[i] =
+                    interpreter_intern_category(interpreter, node->data.parallel_run_statement.category_names[i]);
+            break;
+        case AST_IDENTIFIER:
+            node->data.identifier.slot = interpreter_intern(interpreter, node->data.identifier.name);
+            break;
+        case AST_BINARY_OP:
+            resolve_names(interpreter, node->data.binary_op.left);
+            resolve_names(interpreter, node->data.binary_op.right);
+            break;
+        case AST_UNARY_OP:
+            resolve_names(interpreter, node->data.unary_op.operand);
+            break;
+        case AST_ASSIGNMENT:
+        case AST_RE_ASSIGNMENT:
+        case AST_SUNUM_STATEMENT:
+            node->data.assignment.slot = interpreter_intern(interpreter, node->data.assignment.variable);
+            resolve_names(interpreter, node->data.assignment.expression);
+            break;
+        case AST_NUM_WRITE_STATEMENT:
+            node->data.num_write_statement.slot = interpreter_intern(interpreter, node->data.num_write_statement.variable_name);
+            break;
+        case AST_IF_STATEMENT:
+            resolve_names(interpreter, node->data.if_statement.condition);
+            resolve_names(interpreter, node->data.if_statement.then_stmt);
+            resolve_names(interpreter, node->data.if_statement.else_stmt);
+            break;
+        case AST_COMPOUND_STATEMENT:
+            for (int i = 0; i < node->data.compound_statement.statement_count; i++)
+                resolve_names(interpreter, node->data.compound_statement.statements[i]);
+            break;
+        case AST_CATEGORY_DEFINITION:
+            node->data.category_definition.slot = interpreter_intern_category(interpreter, node->data.category_definition.name);
+            for (int i = 0; i < node->data.category_definition.statement_count; i++)
+                resolve_names(interpreter, node->data.category_definition.statements[i]);
+            break;
+        case AST_FUNCTION_CALL:
+            for (int i = 0; i < node->data.function_call.arg_count; i++)
+                resolve_names(interpreter, node->data.function_call.arguments[i]);
+            break;
+        case AST_WRITE_STATEMENT:
+            resolve_names(interpreter, node->data.write_statement.expression);
+            break;
+    }
+}
@@ -0,0 +1,9 @@
+#ifndef RESOLVER_H
+#define RESOLVER_H
+
+#include "interpreter.h"
+
+// AST中の変数名・カテゴリ名をインターンし、各ノードにスロット番号を書き込む
+void resolve_names(Interpreter* interpreter, ASTNode* node);
+
+#endif
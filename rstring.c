@@ -0,0 +1,92 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "rstring.h"
+
+static size_t rstring_size(int capacity) {
+    return sizeof(RString) + (size_t)capacity + 1;
+}
+
+static RString* rstring_alloc(Allocator* allocator, int length) {
+    RString* string = allocator_alloc(allocator, rstring_size(length), ALLOC_STRINGS);
+    string->allocator = allocator;
+    string->refcount = 1;
+    string->length = length;
+    string->capacity = length;
+    string->hash = 0;
+    string->chars[length] = '\0';
+    return string;
+}
+
+RString* rstring_new(Allocator* allocator, const char* chars, int length) {
+    RString* string = rstring_alloc(allocator, length);
+    memcpy(string->chars, chars, (size_t)length);
+    return string;
+}
+
+RString* rstring_from_cstr(Allocator* allocator, const char* chars) {
+    return rstring_new(allocator, chars, (int)strlen(chars));
+}
+
+RString* rstring_concat(Allocator* allocator, const char* left, int left_length, const char* right, int right_length) {
+    RString* string = rstring_alloc(allocator, left_length + right_length);
+    memcpy(string->chars, left, (size_t)left_length);
+    memcpy(string->chars + left_length, right, (size_t)right_length);
+    return string;
+}
+
+// string の参照を消費して末尾に chars を足した文字列を返す。
+// 他に参照がなければその場で伸ばすので、左結合の連結の連鎖は全体で線形になる
+RString* rstring_append(RString* string, const char* chars, int length) {
+    if (__atomic_load_n(&string->refcount, __ATOMIC_ACQUIRE) != 1) {
+        RString* joined = rstring_concat(string->allocator, string->chars, string->length, chars, length);
+        rstring_release(string);
+        return joined;
+    }
+    int needed = string->length + length;
+    if (needed > string->capacity) {
+        int capacity = string->capacity * 2;
+        if (capacity < needed) capacity = needed;
+        if (capacity < 32) capacity = 32;
+        string = allocator_realloc(string->allocator, string, rstring_size(string->capacity), rstring_size(capacity), ALLOC_STRINGS);
+        string->capacity = capacity;
+    }
+    memcpy(string->chars + string->length, chars, (size_t)length);
+    string->length = needed;
+    string->chars[needed] = '\0';
+    string->hash = 0;
+    return string;
+}
+
+void rstring_free(RString* string) {
+    allocator_free(string->allocator, string, rstring_size(string->capacity), ALLOC_STRINGS);
+}
+
+// FNV-1a。0 は未計算の印なので避ける。
+// 共有された文字列では複数のスレッドが同時に計算しうるが、書く値は同じ
+unsigned rstring_hash(RString* string) {
+    unsigned cached = __atomic_load_n(&string->hash, __ATOMIC_RELAXED);
+    if (cached == 0) {
+        unsigned hash = 2166136261u;
+        for (int i = 0; i < string->length; i++) {
+            hash ^= (unsigned char)string->chars[i];
+            hash *= 16777619u;
+        }
+        cached = hash ? hash : 1;
+        __atomic_store_n(&string->hash, cached, __ATOMIC_RELAXED);
+    }
+    return cached;
+}
+
+int rstring_equals(RString* a, RString* b) {
+    if (a == b) return 1;
+    if (a->length != b->length) return 0;
+    unsigned a_hash = __atomic_load_n(&a->hash, __ATOMIC_RELAXED), b_hash = __atomic_load_n(&b->hash, __ATOMIC_RELAXED);
+    if (a_hash && b_hash && a_hash != b_hash) return 0;
+    return memcmp(a->chars, b->chars, (size_t)a->length) == 0;
+}
+
+int rstring_compare(const RString* a, const RString* b) {
+    if (a == b) return 0;
+    return strcmp(a->chars, b->chars);
+}
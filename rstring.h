@@ -0,0 +1,37 @@
+#ifndef RSTRING_H
+#define RSTRING_H
+
+#include "allocator.h"
+
+// 参照カウント付きの不変文字列。長さとハッシュを持ち、
+// 読み出し・代入はコピーせず参照を増やすだけで済ませる。
+// 参照が1つだけの一時値は連結のバッファとして末尾へ追記できる。
+// prun のワーカー同士で同じ文字列を共有するので、参照カウントはアトミックに増減する
+typedef struct RString {
+    int refcount;
+    int length;
+    int capacity;       // chars に入る文字数（NUL除く）
+    unsigned hash;      // 0 = 未計算
+    Allocator* allocator;   // 解放・伸長に使う（ALLOC_STRINGS）
+    char chars[];       // NUL終端
+} RString;
+
+RString* rstring_new(Allocator* allocator, const char* chars, int length);
+RString* rstring_from_cstr(Allocator* allocator, const char* chars);
+RString* rstring_concat(Allocator* allocator, const char* left, int left_length, const char* right, int right_length);
+RString* rstring_append(RString* string, const char* chars, int length);
+void rstring_free(RString* string);
+unsigned rstring_hash(RString* string);
+int rstring_equals(RString* a, RString* b);
+int rstring_compare(const RString* a, const RString* b);
+
+static inline RString* rstring_retain(RString* string) {
+    __atomic_fetch_add(&string->refcount, 1, __ATOMIC_RELAXED);
+    return string;
+}
+
+static inline void rstring_release(RString* string) {
+    if (__atomic_sub_fetch(&string->refcount, 1, __ATOMIC_ACQ_REL) == 0) rstring_free(string);
+}
+
+#endif
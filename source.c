@@ -0,0 +1,94 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include "source.h"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#define READ_CHUNK (64 * 1024)
+
+// mmap できない入力を最後まで読み込む
+static int source_read_stream(SourceBuffer* source, FILE* file) {
+    size_t capacity = READ_CHUNK, length = 0;
+    char* buffer = malloc(capacity);
+    if (!buffer) return 0;
+    while (1) {
+        if (length == capacity) {
+            capacity *= 2;
+            char* grown = realloc(buffer, capacity);
+            if (!grown) { free(buffer); return 0; }
+            buffer = grown;
+        }
+        size_t n = fread(buffer + length, 1, capacity - length, file);
+        length += n;
+        if (n == 0) break;
+    }
+    if (ferror(file)) {
+        perror("Error reading file");
+        free(buffer);
+        return 0;
+    }
+    if (length > INT_MAX) {
+        fprintf(stderr, "Error reading file: input is too large\n");
+        free(buffer);
+        return 0;
+    }
+    source->data = buffer;
+    source->length = length;
+    source->mapped = 0;
+    return 1;
+}
+
+#ifndef _WIN32
+static int source_map(SourceBuffer* source, int fd, size_t size) {
+    void* data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (data == MAP_FAILED) return 0;
+    posix_madvise(data, size, POSIX_MADV_SEQUENTIAL);
+    source->data = data;
+    source->length = size;
+    source->mapped = 1;
+    return 1;
+}
+#endif
+
+int source_open(SourceBuffer* source, const char* path) {
+    if (strcmp(path, "-") == 0) return source_read_stream(source, stdin);
+
+    FILE* file = fopen(path, "rb");
+    if (!file) { perror("Error opening file"); return 0; }
+#ifndef _WIN32
+    struct stat st;
+    if (fstat(fileno(file), &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+        if ((unsigned long long)st.st_size > INT_MAX) {
+            fprintf(stderr, "Error opening file: %s is too large\n", path);
+            fclose(file);
+            return 0;
+        }
+        if (source_map(source, fileno(file), (size_t)st.st_size)) {
+            fclose(file); // マッピングはファイルを閉じても有効
+            return 1;
+        }
+    }
+#endif
+    int ok = source_read_stream(source, file);
+    fclose(file);
+    return ok;
+}
+
+void source_close(SourceBuffer* source) {
+#ifndef _WIN32
+    if (source->mapped) {
+        munmap((void*)source->data, source->length);
+        source->data = NULL;
+        return;
+    }
+#endif
+    free((void*)source->data);
+    source->data = NULL;
+}
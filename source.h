@@ -0,0 +1,18 @@
+#ifndef SOURCE_H
+#define SOURCE_H
+
+#include <stddef.h>
+
+// スクリプトのソースバッファ。通常ファイルは読み取り専用で mmap し、
+// 標準入力やパイプは逐次読み込んでヒープに置く。NUL終端は保証しない
+typedef struct {
+    const char* data;
+    size_t length;
+    int mapped;
+} SourceBuffer;
+
+// path が "-" なら標準入力から読む。失敗したら 0 を返す
+int source_open(SourceBuffer* source, const char* path);
+void source_close(SourceBuffer* source);
+
+#endif
@@ -0,0 +1,86 @@
+#include <time.h>
+#include "stats.h"
+
+#ifdef STRINGS_STATS
+Stats stats;
+#endif
+
+#if defined(__SANITIZE_ADDRESS__) || defined(__SANITIZE_THREAD__)
+#define STATS_SANITIZED 1
+#elif defined(__has_feature)
+#if __has_feature(address_sanitizer) || __has_feature(thread_sanitizer)
+#define STATS_SANITIZED 1
+#endif
+#endif
+
+// --- Allocation Counting ---
+// glibc の malloc 一式を差し替えて数える。解放時の大きさは malloc_usable_size で求める。
+// 出力スレッドからも呼ばれるのでカウンタはアトミックに更新する。
+// プロセス全体の割り当てが遅くなるので、STRINGS_COUNT_MALLOC を定義したビルドでのみ差し替える
+#if defined(STRINGS_STATS) && defined(STRINGS_COUNT_MALLOC) && defined(__GLIBC__) && !defined(STATS_SANITIZED)
+#include <stddef.h>
+#include <malloc.h>
+
+extern void* __libc_malloc(size_t size);
+extern void* __libc_calloc(size_t count, size_t size);
+extern void* __libc_realloc(void* ptr, size_t size);
+extern void __libc_free(void* ptr);
+
+static void add_live_bytes(long long delta) {
+    long long live = __atomic_add_fetch(&stats.live_bytes, delta, __ATOMIC_RELAXED);
+    long long peak = __atomic_load_n(&stats.peak_bytes, __ATOMIC_RELAXED);
+    while (live > peak && !__atomic_compare_exchange_n(&stats.peak_bytes, &peak, live, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {}
+}
+
+static void* count_alloc(void* ptr) {
+    if (!ptr) return NULL;
+    __atomic_fetch_add(&stats.mallocs, 1, __ATOMIC_RELAXED);
+    add_live_bytes((long long)malloc_usable_size(ptr));
+    return ptr;
+}
+
+void* malloc(size_t size) {
+    return count_alloc(__libc_malloc(size));
+}
+
+void* calloc(size_t count, size_t size) {
+    return count_alloc(__libc_calloc(count, size));
+}
+
+// 伸縮は回数に数えず、大きさの差だけ反映する
+void* realloc(void* ptr, size_t size) {
+    if (!ptr) return malloc(size);
+    if (size == 0) { free(ptr); return NULL; }
+    long long old_size = (long long)malloc_usable_size(ptr);
+    void* grown = __libc_realloc(ptr, size);
+    if (grown) add_live_bytes((long long)malloc_usable_size(grown) - old_size);
+    return grown;
+}
+
+void free(void* ptr) {
+    if (!ptr) return;
+    __atomic_fetch_add(&stats.frees, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_sub(&stats.live_bytes, (long long)malloc_usable_size(ptr), __ATOMIC_RELAXED);
+    __libc_free(ptr);
+}
+
+int stats_counts_allocations(void) { return 1; }
+#else
+int stats_counts_allocations(void) { return 0; }
+#endif
+
+// --- Clock ---
+StatsTime stats_now(void) {
+    StatsTime now;
+#ifdef _WIN32
+    now.wall = (double)clock() / CLOCKS_PER_SEC;
+    now.cpu = now.wall;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    now.wall = ts.tv_sec + ts.tv_nsec / 1e9;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    now.cpu = ts.tv_sec + ts.tv_nsec / 1e9;
+#endif
+    return now;
+}
@@ -0,0 +1,39 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include "parser.h"
+
+// --stats 用のカウンタ。STRINGS_STATS を定義せずにビルドすると STATS_* は何もしない
+#define AST_NODE_TYPE_COUNT (AST_PARALLEL_RUN_STATEMENT + 1)
+
+typedef struct {
+    long long ast_nodes[AST_NODE_TYPE_COUNT];  // 種類別の生成ノード数（最適化で作られたものを含む）
+    long long statements;                       // 実行した文の数
+    long long mallocs;                          // malloc/calloc/realloc(NULL) の回数
+    long long frees;
+    long long live_bytes;
+    long long peak_bytes;
+} Stats;
+
+#ifdef STRINGS_STATS
+extern Stats stats;
+// prun のワーカーからも数えるのでアトミックに足す
+#define STATS_INC(field) ((void)__atomic_fetch_add(&stats.field, 1, __ATOMIC_RELAXED))
+#define STATS_ADD(field, n) ((void)__atomic_fetch_add(&stats.field, (n), __ATOMIC_RELAXED))
+#else
+#define STATS_INC(field) ((void)0)
+#define STATS_ADD(field, n) ((void)0)
+#endif
+
+// 割り当てを数えるビルドなら 1（STRINGS_COUNT_MALLOC を定義した glibc のみ。サニタイザとは併用しない）
+int stats_counts_allocations(void);
+
+// 経過時間と CPU 時間（秒）
+typedef struct {
+    double wall;
+    double cpu;
+} StatsTime;
+
+StatsTime stats_now(void);
+
+#endif
@@ -0,0 +1,86 @@
+#include <stdlib.h>
+#include <string.h>
+#include "symbols.h"
+
+void symbol_table_init(SymbolTable* table, Allocator* allocator, AllocTag tag) {
+    table->allocator = allocator;
+    table->tag = tag;
+    table->count = 0;
+    table->capacity = 16;
+    table->names = allocator_alloc(allocator, sizeof(char*) * table->capacity, tag);
+    table->hashes = allocator_alloc(allocator, sizeof(unsigned) * table->capacity, tag);
+    table->bucket_count = 32;
+    table->buckets = allocator_calloc(allocator, table->bucket_count, sizeof(int), tag);
+}
+
+void symbol_table_free(SymbolTable* table) {
+    Allocator* allocator = table->allocator;
+    for (int i = 0; i < table->count; i++) allocator_free_string(allocator, table->names[i], table->tag);
+    allocator_free(allocator, table->names, sizeof(char*) * table->capacity, table->tag);
+    allocator_free(allocator, table->hashes, sizeof(unsigned) * table->capacity, table->tag);
+    allocator_free(allocator, table->buckets, sizeof(int) * table->bucket_count, table->tag);
+    table->names = NULL;
+    table->hashes = NULL;
+    table->buckets = NULL;
+    table->count = table->capacity = table->bucket_count = 0;
+}
+
+// FNV-1a
+unsigned symbol_hash(const char* name) {
+    unsigned hash = 2166136261u;
+    for (const unsigned char* p = (const unsigned char*)name; *p; p++) {
+        hash ^= *p;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+static int find_bucket(const SymbolTable* table, const char* name, unsigned hash) {
+    unsigned mask = (unsigned)table->bucket_count - 1;
+    unsigned index = hash & mask;
+    while (table->buckets[index] != 0) {
+        int slot = table->buckets[index] - 1;
+        if (table->hashes[slot] == hash && strcmp(table->names[slot], name) == 0) return (int)index;
+        index = (index + 1) & mask;
+    }
+    return (int)index;
+}
+
+static void rehash(SymbolTable* table) {
+    allocator_free(table->allocator, table->buckets, sizeof(int) * table->bucket_count, table->tag);
+    table->bucket_count *= 2;
+    table->buckets = allocator_calloc(table->allocator, table->bucket_count, sizeof(int), table->tag);
+    unsigned mask = (unsigned)table->bucket_count - 1;
+    for (int slot = 0; slot < table->count; slot++) {
+        unsigned index = table->hashes[slot] & mask;
+        while (table->buckets[index] != 0) index = (index + 1) & mask;
+        table->buckets[index] = slot + 1;
+    }
+}
+
+int symbol_lookup(const SymbolTable* table, const char* name) {
+    int bucket = find_bucket(table, name, symbol_hash(name));
+    return table->buckets[bucket] - 1;
+}
+
+int symbol_intern(SymbolTable* table, const char* name) {
+    unsigned hash = symbol_hash(name);
+    int bucket = find_bucket(table, name, hash);
+    if (table->buckets[bucket] != 0) return table->buckets[bucket] - 1;
+
+    if (table->count >= table->capacity) {
+        int old_capacity = table->capacity;
+        table->capacity *= 2;
+        table->names = allocator_realloc(table->allocator, table->names, sizeof(char*) * old_capacity,
+                                         sizeof(char*) * table->capacity, table->tag);
+        table->hashes = allocator_realloc(table->allocator, table->hashes, sizeof(unsigned) * old_capacity,
+                                          sizeof(unsigned) * table->capacity, table->tag);
+    }
+    int slot = table->count++;
+    table->names[slot] = allocator_strdup(table->allocator, name, table->tag);
+    table->hashes[slot] = hash;
+    // 負荷率を 1/2 以下に保つ
+    if (table->count * 2 > table->bucket_count) rehash(table);
+    else table->buckets[bucket] = slot + 1;
+    return slot;
+}
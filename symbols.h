@@ -0,0 +1,24 @@
+#ifndef SYMBOLS_H
+#define SYMBOLS_H
+
+#include "allocator.h"
+
+// 識別子のインターン表。名前ごとに 0 から始まる連番のスロットを割り当てる
+typedef struct {
+    char** names;       // スロット -> 名前
+    unsigned* hashes;   // スロット -> ハッシュ値
+    int count;
+    int capacity;
+    int* buckets;       // オープンアドレス法。スロット+1 を格納、0 は空き
+    int bucket_count;   // 2のべき乗
+    Allocator* allocator;
+    AllocTag tag;
+} SymbolTable;
+
+void symbol_table_init(SymbolTable* table, Allocator* allocator, AllocTag tag);
+void symbol_table_free(SymbolTable* table);
+unsigned symbol_hash(const char* name);
+int symbol_intern(SymbolTable* table, const char* name);
+int symbol_lookup(const SymbolTable* table, const char* name);
+
+#endif
@@ -0,0 +1,106 @@
+// libstrings の API のテスト。1つのプログラムを一度だけコンパイルし、
+// 複数のスレッドでそれぞれのコンテキストに別の入力を入れて何度も実行する
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "../libstrings.h"
+
+#define THREAD_COUNT 8
+#define RUNS 200
+
+static const char* source =
+    "greeting = \"Hello, \" + name /\n"
+    "write greeting /\n"
+    "total = count @ '2' /\n"
+    "num write total /\n"
+    "i = '0' /\n"
+    "func loop()\n"
+    "    re i = i + '1' /\n"
+    "    i < count / ? run loop /\n"
+    "end\n"
+    "run loop /\n"
+    "count > '5' / ? write \"big\" / ! write \"small\" /\n";
+
+static const char* inputs[] = { "name", "count" };
+
+static StringsProgram* program;
+
+static int check(int condition, const char* what, int thread) {
+    if (!condition) fprintf(stderr, "library: thread %d: %s\n", thread, what);
+    return condition ? 0 : 1;
+}
+
+static void* worker_main(void* arg) {
+    int index = (int)(size_t)arg, failures = 0;
+    StringsContext* context = strings_context_create(program);
+    char name[32], expected[128];
+    for (int run = 0; run < RUNS && !failures; run++) {
+        int count = index + run % 10 + 1;
+        snprintf(name, sizeof(name), "user%d", index);
+        strings_set_string(context, "name", name, strlen(name));
+        strings_set_number(context, "count", count);
+        failures += check(strings_run(context), "run reported errors", index);
+        snprintf(expected, sizeof(expected), "Hello, %s\n%d\n%s\n", name, count * 2, count > 5 ? "big" : "small");
+        size_t length;
+        const char* output = strings_output(context, &length);
+        failures += check(length == strlen(expected) && memcmp(output, expected, length) == 0, "unexpected output", index);
+        double total = 0, i = 0;
+        failures += check(strings_get_number(context, "total", &total) && total == count * 2, "total", index);
+        failures += check(strings_get_number(context, "i", &i) && i == count, "loop counter", index);
+        const char* greeting = strings_get_string(context, "greeting", &length);
+        failures += check(greeting && length == strlen(name) + 7 && memcmp(greeting + 7, name, strlen(name)) == 0, "greeting", index);
+    }
+    strings_context_free(context);
+    return (void*)(size_t)failures;
+}
+
+int main(void) {
+    int failures = 0;
+    char* errors = NULL;
+    StringsProgram* broken = strings_compile("x = /\n", 6, NULL, 0, &errors);
+    failures += check(!broken && errors && strstr(errors, "Parse error"), "parse errors are reported", -1);
+    free(errors);
+    StringsProgram* empty = strings_compile("# nothing\n//\n", 13, NULL, 0, &errors);
+    failures += check(empty && !errors, "an empty source compiles", -1);
+    if (empty) {
+        StringsContext* context = strings_context_create(empty);
+        size_t length;
+        failures += check(strings_run(context) && strings_output(context, &length)[0] == '\0', "an empty program runs", -1);
+        strings_context_free(context);
+        strings_program_free(empty);
+    }
+
+    program = strings_compile(source, strlen(source), inputs, 2, &errors);
+    if (!program) {
+        fprintf(stderr, "library: compile failed: %s", errors ? errors : "");
+        free(errors);
+        return 1;
+    }
+    StringsContext* context = strings_context_create(program);
+    failures += check(!strings_set_number(context, "total", 1), "only inputs can be set", -1);
+    strings_set_number(context, "count", 1);
+    failures += check(!strings_run(context), "undefined input is a runtime error", -1);
+    size_t length;
+    failures += check(strstr(strings_errors(context, &length), "Undefined variable 'name'") != NULL, "error text", -1);
+    strings_context_free(context);
+
+    pthread_t threads[THREAD_COUNT];
+    for (int i = 0; i < THREAD_COUNT; i++)
+        if (pthread_create(&threads[i], NULL, worker_main, (void*)(size_t)i) != 0) {
+            perror("Error starting thread");
+            return 1;
+        }
+    for (int i = 0; i < THREAD_COUNT; i++) {
+        void* result;
+        pthread_join(threads[i], &result);
+        failures += (int)(size_t)result;
+    }
+    strings_program_free(program);
+    if (failures) {
+        fprintf(stderr, "library: %d checks failed\n", failures);
+        return 1;
+    }
+    printf("library: %d threads x %d runs of one compiled program\n", THREAD_COUNT, RUNS);
+    return 0;
+}
@@ -0,0 +1,227 @@
+// 再入性のテスト。同じスクリプト群を1つのスレッドで順に実行した結果と、
+// 複数のスレッドでそれぞれ別のインタプリタを同時に動かした結果（標準出力とエラーの並び）が
+// バイト単位で一致することを確かめる
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "../parser.h"
+#include "../interpreter.h"
+#include "../resolver.h"
+#include "../optimizer.h"
+#include "../inference.h"
+#include "../compiler.h"
+#include "../vm.h"
+#include "../output.h"
+
+#define THREAD_COUNT 8
+#define ROUNDS 20
+
+// --- Scripts ---
+static const char* scripts[] = {
+    // 数値と文字列
+    "a = '10' /\n"
+    "b = \"abc\" /\n"
+    "num write a /\n"
+    "num write b /\n"
+    "z = a @ '3' + '1' /\n"
+    "num write z /\n"
+    "s = \"hello\" + \" \" + \"world\" + z /\n"
+    "write s /\n"
+    "b == \"abc\" / ? write \"equal\" / ! write \"not equal\" /\n"
+    "write '7' % '3' /\n"
+    "write '7' \\ '2' /\n"
+    "write ~ \"\" /\n",
+    // 再帰と連結
+    "n = '0' /\n"
+    "acc = \"\" /\n"
+    "func loop()\n"
+    "    re n = n + '1' /\n"
+    "    re acc = acc + n + \",\" /\n"
+    "    n < '300' / ? run loop /\n"
+    "end\n"
+    "run loop /\n"
+    "num write n /\n"
+    "write acc /\n"
+    "sunum n /\n"
+    "re n = n @ '2' /\n"
+    "num write n /\n",
+    // 実行時エラーと出力の並び
+    "write \"before\" /\n"
+    "write '1' \\ '0' /\n"
+    "write zz /\n"
+    "re qq = '1' /\n"
+    "run nothere /\n"
+    "write \"a\" - \"b\" /\n"
+    "write \"after\" /\n",
+    // カテゴリの再定義と call
+    "func twice()\n"
+    "  write \"once\" /\n"
+    "end\n"
+    "func twice()\n"
+    "  write \"twice\" /\n"
+    "end\n"
+    "run twice /\n"
+    "func outer()\n"
+    "  func inner()\n"
+    "    write \"inner\" /\n"
+    "  end\n"
+    "end\n"
+    "run inner /\n"
+    "run outer /\n"
+    "run inner /\n"
+    "call py \"print(1)\" /\n",
+    // prun（入れ子のワーカーの出力も呼び出し元のインタプリタへ戻る）
+    "base = \"shared\" /\n"
+    "func left()\n"
+    "    write \"left \" + base /\n"
+    "    x = '1' /\n"
+    "    sunum x /\n"
+    "end\n"
+    "func right()\n"
+    "    write \"right\" /\n"
+    "    missing /\n"
+    "end\n"
+    "func both()\n"
+    "    prun left right /\n"
+    "end\n"
+    "prun both right left /\n"
+    "num write x /\n"
+    "prun left nosuch /\n",
+    // 構文エラー
+    "write \"unused\" /\n"
+    "x = /\n",
+};
+
+#define SCRIPT_COUNT ((int)(sizeof(scripts) / sizeof(scripts[0])))
+#define JOB_COUNT (SCRIPT_COUNT * 2)   // VM とツリーウォーカー
+
+// --- Runner ---
+// main.c の execute_source と同じ手順で、出力とエラーをすべて capture に溜めて実行する
+static void run_script(const char* source, int tree_walk, OutputCapture* capture) {
+    OutputSink output = output_capture_sink(capture, OUTPUT_STDOUT);
+    OutputSink errors = output_capture_sink(capture, OUTPUT_STDERR);
+    Arena arena;
+    arena_init(&arena, allocator_default(), ALLOC_AST);
+    Parser* parser = parser_create(source, (int)strlen(source), &arena, allocator_default());
+    parser->errors = errors;
+    ASTNode* ast = parse(parser);
+    parser_free(parser);
+    if (!ast) {
+        arena_free(&arena);
+        return;
+    }
+    Interpreter* interpreter = interpreter_create(allocator_default());
+    interpreter->output = output;
+    interpreter->errors = errors;
+    Program* program = NULL;
+    ast = optimize(ast, &arena);
+    resolve_names(interpreter, ast);
+    infer_types(interpreter, ast, NULL);
+    if (tree_walk) {
+        interpret(interpreter, ast);
+    } else if ((program = compile(ast, interpreter))) {
+        VM* vm = vm_create(interpreter);
+        vm_run(vm, program);
+        vm_free(vm);
+    }
+    program_free(program);
+    interpreter_free(interpreter);
+    arena_free(&arena);
+}
+
+static void run_job(int job, OutputCapture* capture) {
+    output_capture_init(capture);
+    run_script(scripts[job / 2], job % 2, capture);
+}
+
+// --- Threads ---
+static OutputCapture expected[JOB_COUNT];
+
+typedef struct {
+    int index;
+    int failures;
+} Worker;
+
+// スレッドごとにずらした順で全ジョブを繰り返す
+static void* worker_main(void* arg) {
+    Worker* worker = arg;
+    for (int round = 0; round < ROUNDS; round++) {
+        for (int i = 0; i < JOB_COUNT; i++) {
+            int job = (worker->index + round + i) % JOB_COUNT;
+            OutputCapture actual;
+            run_job(job, &actual);
+            if (actual.length != expected[job].length || memcmp(actual.data, expected[job].data, actual.length) != 0) {
+                fprintf(stderr, "reentrancy: thread %d, script %d (%s) differs from the serial run\n",
+                        worker->index, job / 2, job % 2 ? "tree-walk" : "vm");
+                worker->failures++;
+            }
+            free(actual.data);
+        }
+    }
+    return NULL;
+}
+
+static void append_text(void* context, const char* data, size_t length) {
+    char* text = context;
+    size_t used = strlen(text);
+    if (used + length >= 1024) length = 1023 - used;
+    memcpy(text + used, data, length);
+    text[used + length] = '\0';
+}
+
+// prun のワーカーは起動元の記号表・カテゴリ表を読むだけで、名前を増やせない
+static int check_worker_names(void) {
+    static char errors[1024];
+    Interpreter* parent = interpreter_create(allocator_default());
+    parent->errors.write = append_text;
+    parent->errors.context = errors;
+    int known = interpreter_intern(parent, "known");
+    Interpreter* worker = interpreter_create_worker(parent);
+    int failures = interpreter_intern(worker, "known") != known;
+    set_variable(worker, "fresh", create_number_result(1), 0);
+    run_category(worker, "missing");
+    failures += symbol_lookup(&parent->symbols, "fresh") >= 0 || parent->symbols.count != 1;
+    failures += symbol_lookup(&parent->category_names, "missing") >= 0;
+    failures += strstr(errors, "Cannot add variable 'fresh' inside prun") == NULL
+             || strstr(errors, "Cannot add category 'missing' inside prun") == NULL;
+    interpreter_free_worker(worker);
+    interpreter_free(parent);
+    if (failures) fprintf(stderr, "reentrancy: a prun worker changed its parent's name tables\n");
+    return failures;
+}
+
+int main(void) {
+    if (check_worker_names()) return 1;
+    for (int job = 0; job < JOB_COUNT; job++) run_job(job, &expected[job]);
+    // 出力先が空なら比較の意味がないので、どのジョブも何かを書いていること
+    for (int job = 0; job < JOB_COUNT; job++) {
+        if (expected[job].length == 0) {
+            fprintf(stderr, "reentrancy: script %d produced no output\n", job / 2);
+            return 1;
+        }
+    }
+
+    Worker workers[THREAD_COUNT];
+    pthread_t threads[THREAD_COUNT];
+    for (int i = 0; i < THREAD_COUNT; i++) {
+        workers[i].index = i;
+        workers[i].failures = 0;
+        if (pthread_create(&threads[i], NULL, worker_main, &workers[i]) != 0) {
+            perror("Error starting thread");
+            return 1;
+        }
+    }
+    int failures = 0;
+    for (int i = 0; i < THREAD_COUNT; i++) {
+        pthread_join(threads[i], NULL);
+        failures += workers[i].failures;
+    }
+    for (int job = 0; job < JOB_COUNT; job++) free(expected[job].data);
+    if (failures) {
+        fprintf(stderr, "reentrancy: %d of %d runs differ\n", failures, THREAD_COUNT * ROUNDS * JOB_COUNT);
+        return 1;
+    }
+    printf("reentrancy: %d threads x %d runs match the serial output\n", THREAD_COUNT, ROUNDS * JOB_COUNT);
+    return 0;
+}
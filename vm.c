@@ -0,0 +1,371 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "vm.h"
+#include "output.h"
+#include "stats.h"
+#include "profile.h"
+#include "parallel.h"
+
+// GCCではcomputed gotoでディスパッチする
+#if defined(__GNUC__) && !defined(STRINGS_NO_COMPUTED_GOTO)
+#define USE_COMPUTED_GOTO 1
+#else
+#define USE_COMPUTED_GOTO 0
+#endif
+
+VM* vm_create(Interpreter* interpreter) {
+    VM* vm = allocator_alloc(interpreter->allocator, sizeof(VM), ALLOC_CODE);
+    vm->interpreter = interpreter;
+    vm->register_capacity = 64;
+    vm->register_top = 0;
+    vm->registers = allocator_alloc(interpreter->allocator, sizeof(EvalResult) * vm->register_capacity, ALLOC_CODE);
+    return vm;
+}
+
+void vm_free(VM* vm) {
+    if (!vm) return;
+    Allocator* allocator = vm->interpreter->allocator;
+    allocator_free(allocator, vm->registers, sizeof(EvalResult) * vm->register_capacity, ALLOC_CODE);
+    allocator_free(allocator, vm, sizeof(VM), ALLOC_CODE);
+}
+
+static EvalResult take_register(EvalResult* reg) {
+    EvalResult value = *reg;
+    reg->type = RESULT_NUMBER;
+    reg->value.number = 0;
+    return value;
+}
+
+
+// --- Quickening ---
+// 特化命令のガードにこの回数外れたサイトは、以後汎用命令のまま実行する
+#define QUICKEN_LIMIT 4
+
+// 文字列同士で特化できる演算子（なければ op をそのまま返す）
+static uint8_t string_specialization(uint8_t op) {
+    switch (op) {
+        case OP_ADD: return OP_ADD_STR;
+        case OP_EQ: return OP_EQ_STR;
+        case OP_NEQ: return OP_NEQ_STR;
+        default: return op;
+    }
+}
+
+// 命令ハンドラの外に出しておくと vm_execute のスタックフレームが小さく保てる（run の再帰が深いため）
+static void binary_generic(VM* vm, EvalResult* r, const Instruction* ip, OpCode op) {
+    EvalResult lhs = take_register(&r[ip->b]);
+    EvalResult rhs = take_register(&r[ip->c]);
+    r[ip->a] = apply_binary_op(vm->interpreter->allocator, &vm->interpreter->errors, opcode_to_operator(op), lhs, rhs);
+}
+
+static void binary_concat_strings(VM* vm, EvalResult* r, const Instruction* ip) {
+    EvalResult lhs = take_register(&r[ip->b]);
+    EvalResult rhs = take_register(&r[ip->c]);
+    r[ip->a] = concat_string_result(vm->interpreter->allocator, lhs, result_chars(&rhs), result_length(&rhs));
+    release_result(rhs);
+}
+
+static void binary_string_equality(EvalResult* r, const Instruction* ip, int negate) {
+    EvalResult lhs = take_register(&r[ip->b]);
+    EvalResult rhs = take_register(&r[ip->c]);
+    int equal = string_results_equal(&lhs, &rhs);
+    release_result(lhs);
+    release_result(rhs);
+    r[ip->a] = create_number_result(equal != negate ? 1.0 : 0.0);
+}
+
+// prun のカテゴリスロットは数値定数として並んでいる
+static void parallel_run_constants(VM* vm, const EvalResult* k, const Instruction* ip) {
+    Allocator* allocator = vm->interpreter->allocator;
+    int* slots = allocator_alloc(allocator, sizeof(int) * (ip->c ? ip->c : 1), ALLOC_CODE);
+    for (uint32_t i = 0; i < ip->c; i++) slots[i] = (int)k[ip->b + i].value.number;
+    parallel_run(vm->interpreter, slots, (int)ip->c);
+    allocator_free(allocator, slots, sizeof(int) * (ip->c ? ip->c : 1), ALLOC_CODE);
+}
+
+static void grow_registers(VM* vm, int needed) {
+    int old_capacity = vm->register_capacity;
+    while (needed > vm->register_capacity) vm->register_capacity *= 2;
+    vm->registers = allocator_realloc(vm->interpreter->allocator, vm->registers, sizeof(EvalResult) * old_capacity,
+                                      sizeof(EvalResult) * vm->register_capacity, ALLOC_CODE);
+}
+
+// 型特化の書き換えは prun のワーカー同士で同じ命令に対して起こりうるので、
+// 命令の種類はアトミックに読み書きする（どちらの書き換えが残っても意味は同じ）
+#define LOAD_OP(ip) __atomic_load_n(&(ip)->op, __ATOMIC_RELAXED)
+#define STORE_OP(ip, value) __atomic_store_n(&(ip)->op, (uint8_t)(value), __ATOMIC_RELAXED)
+#define LOAD_DEOPTS(ip) __atomic_load_n(&(ip)->deopts, __ATOMIC_RELAXED)
+#define STORE_DEOPTS(ip, value) __atomic_store_n(&(ip)->deopts, (uint8_t)(value), __ATOMIC_RELAXED)
+
+static void vm_execute(VM* vm, const Function* function) {
+    const EvalResult* k = function->program->constants;
+    Instruction* code = function->code;     // 型特化のため実行中に書き換える
+    Instruction* ip = code;
+    int base = vm->register_top;
+
+    if (base + function->register_count > vm->register_capacity) grow_registers(vm, base + function->register_count);
+    EvalResult* r = vm->registers + base;
+    for (int i = 0; i < function->register_count; i++) {
+        r[i].type = RESULT_NUMBER;
+        r[i].value.number = 0;
+    }
+    vm->register_top += function->register_count;
+
+#if USE_COMPUTED_GOTO
+    static void* dispatch_table[OP_COUNT] = {
+        [OP_LOAD_CONST] = &&do_OP_LOAD_CONST, [OP_GET_VAR] = &&do_OP_GET_VAR,
+        [OP_SET_VAR] = &&do_OP_SET_VAR, [OP_RE_SET_VAR] = &&do_OP_RE_SET_VAR,
+        [OP_GET_NUM] = &&do_OP_GET_NUM, [OP_SET_NUM] = &&do_OP_SET_NUM, [OP_RE_SET_NUM] = &&do_OP_RE_SET_NUM,
+        [OP_SUNUM] = &&do_OP_SUNUM,
+        [OP_ADD] = &&do_OP_ADD, [OP_SUB] = &&do_OP_SUB, [OP_MUL] = &&do_OP_MUL,
+        [OP_DIV] = &&do_OP_DIV, [OP_MOD] = &&do_OP_MOD,
+        [OP_GT] = &&do_OP_GT, [OP_LT] = &&do_OP_LT, [OP_GTE] = &&do_OP_GTE,
+        [OP_LTE] = &&do_OP_LTE, [OP_EQ] = &&do_OP_EQ, [OP_NEQ] = &&do_OP_NEQ,
+        [OP_AND] = &&do_OP_AND, [OP_OR] = &&do_OP_OR,
+        [OP_POS] = &&do_OP_POS, [OP_NEG] = &&do_OP_NEG, [OP_NOT] = &&do_OP_NOT,
+        [OP_WRITE] = &&do_OP_WRITE, [OP_NUM_WRITE] = &&do_OP_NUM_WRITE,
+        [OP_DISCARD] = &&do_OP_DISCARD, [OP_JUMP] = &&do_OP_JUMP,
+        [OP_JUMP_IF_FALSE] = &&do_OP_JUMP_IF_FALSE,
+        [OP_DEFINE_CATEGORY] = &&do_OP_DEFINE_CATEGORY, [OP_RUN] = &&do_OP_RUN,
+        [OP_CALL] = &&do_OP_CALL, [OP_CALL_VALUE] = &&do_OP_CALL_VALUE,
+        [OP_PRUN] = &&do_OP_PRUN, [OP_RETURN] = &&do_OP_RETURN, [OP_STMT] = &&do_OP_STMT,
+        [OP_ADD_NUM] = &&do_OP_ADD_NUM, [OP_SUB_NUM] = &&do_OP_SUB_NUM, [OP_MUL_NUM] = &&do_OP_MUL_NUM,
+        [OP_DIV_NUM] = &&do_OP_DIV_NUM, [OP_MOD_NUM] = &&do_OP_MOD_NUM,
+        [OP_GT_NUM] = &&do_OP_GT_NUM, [OP_LT_NUM] = &&do_OP_LT_NUM, [OP_GTE_NUM] = &&do_OP_GTE_NUM,
+        [OP_LTE_NUM] = &&do_OP_LTE_NUM, [OP_EQ_NUM] = &&do_OP_EQ_NUM, [OP_NEQ_NUM] = &&do_OP_NEQ_NUM,
+        [OP_AND_NUM] = &&do_OP_AND_NUM, [OP_OR_NUM] = &&do_OP_OR_NUM,
+        [OP_ADD_STR] = &&do_OP_ADD_STR, [OP_EQ_STR] = &&do_OP_EQ_STR, [OP_NEQ_STR] = &&do_OP_NEQ_STR,
+    };
+#define CASE(op) do_##op:
+#define DISPATCH() goto *dispatch_table[LOAD_OP(ip)]
+#define NEXT() do { ip++; DISPATCH(); } while (0)
+    DISPATCH();
+#else
+#define CASE(op) case op:
+#define DISPATCH() goto dispatch
+#define NEXT() do { ip++; goto dispatch; } while (0)
+dispatch:
+    switch ((OpCode)LOAD_OP(ip)) {
+#endif
+
+    CASE(OP_LOAD_CONST)
+        r[ip->a] = retain_result(k[ip->b]);
+        NEXT();
+    CASE(OP_GET_VAR)
+        r[ip->a] = evaluate_variable_slot(vm->interpreter, (int)ip->b);
+        NEXT();
+    CASE(OP_SET_VAR) {
+        set_variable_slot(vm->interpreter, (int)ip->b, take_register(&r[ip->a]), 0);
+        NEXT();
+    }
+    CASE(OP_RE_SET_VAR) {
+        reassign_variable_slot(vm->interpreter, (int)ip->b, take_register(&r[ip->a]));
+        NEXT();
+    }
+    // 型推論で数値と証明された変数はタグを見ずに読み書きする（値は常に数値）
+    CASE(OP_GET_NUM) {
+        const double* number = &vm->interpreter->numbers[ip->b];
+        if (number_slot_defined(number)) {
+            r[ip->a].value.number = *number;
+            r[ip->a].type = RESULT_NUMBER;
+        } else {
+            r[ip->a] = evaluate_variable_slot(vm->interpreter, (int)ip->b);
+        }
+        NEXT();
+    }
+    CASE(OP_SET_NUM)
+        set_number_slot(vm->interpreter, (int)ip->b, r[ip->a].value.number);
+        NEXT();
+    CASE(OP_RE_SET_NUM)
+        reassign_number_slot(vm->interpreter, (int)ip->b, r[ip->a].value.number);
+        NEXT();
+    CASE(OP_SUNUM)
+        set_shared_variable_slot(vm->interpreter, (int)ip->b);
+        NEXT();
+
+    // 汎用の二項演算。オペランドの型を見て型特化命令へ書き換え、書き換えた命令を実行し直す。
+    // 特化できない組み合わせや、特化が何度も外れたサイトは共通の意味論に任せる
+#define BINARY_OP(opcode)                                                    \
+    CASE(opcode) {                                                           \
+        EvalResult* left = &r[ip->b];                                        \
+        EvalResult* right = &r[ip->c];                                       \
+        if (LOAD_DEOPTS(ip) < QUICKEN_LIMIT) {                               \
+            if (left->type == RESULT_NUMBER && right->type == RESULT_NUMBER) { \
+                STORE_OP(ip, OP_ADD_NUM + (opcode - OP_ADD));                \
+                DISPATCH();                                                  \
+            }                                                                \
+            if (left->type != RESULT_NUMBER && right->type != RESULT_NUMBER  \
+                && string_specialization(opcode) != opcode) {                \
+                STORE_OP(ip, string_specialization(opcode));                 \
+                DISPATCH();                                                  \
+            }                                                                \
+        }                                                                    \
+        binary_generic(vm, r, ip, opcode);                                   \
+        NEXT();                                                              \
+    }
+    BINARY_OP(OP_ADD)
+    BINARY_OP(OP_SUB)
+    BINARY_OP(OP_MUL)
+    BINARY_OP(OP_DIV)
+    BINARY_OP(OP_MOD)
+    BINARY_OP(OP_GT)
+    BINARY_OP(OP_LT)
+    BINARY_OP(OP_GTE)
+    BINARY_OP(OP_LTE)
+    BINARY_OP(OP_EQ)
+    BINARY_OP(OP_NEQ)
+    BINARY_OP(OP_AND)
+    BINARY_OP(OP_OR)
+#undef BINARY_OP
+
+    // ガードに外れた特化命令は汎用命令へ戻して実行し直す
+#define DEOPTIMIZE(generic) do { STORE_OP(ip, generic); STORE_DEOPTS(ip, LOAD_DEOPTS(ip) + 1); DISPATCH(); } while (0)
+
+#define NUMBER_OP(opcode, expr)                                              \
+    CASE(opcode) {                                                           \
+        EvalResult* left = &r[ip->b];                                        \
+        EvalResult* right = &r[ip->c];                                       \
+        if (left->type != RESULT_NUMBER || right->type != RESULT_NUMBER)     \
+            DEOPTIMIZE(OP_ADD + (opcode - OP_ADD_NUM));                      \
+        double lv = left->value.number, rv = right->value.number;            \
+        r[ip->a].value.number = (expr);                                      \
+        r[ip->a].type = RESULT_NUMBER;                                       \
+        NEXT();                                                              \
+    }
+    NUMBER_OP(OP_ADD_NUM, lv + rv)
+    NUMBER_OP(OP_SUB_NUM, lv - rv)
+    NUMBER_OP(OP_MUL_NUM, lv * rv)
+    NUMBER_OP(OP_MOD_NUM, fmod(lv, rv))
+    NUMBER_OP(OP_GT_NUM, lv > rv ? 1.0 : 0.0)
+    NUMBER_OP(OP_LT_NUM, lv < rv ? 1.0 : 0.0)
+    NUMBER_OP(OP_GTE_NUM, lv >= rv ? 1.0 : 0.0)
+    NUMBER_OP(OP_LTE_NUM, lv <= rv ? 1.0 : 0.0)
+    NUMBER_OP(OP_EQ_NUM, lv == rv ? 1.0 : 0.0)
+    NUMBER_OP(OP_NEQ_NUM, lv != rv ? 1.0 : 0.0)
+    NUMBER_OP(OP_AND_NUM, (lv != 0 && rv != 0) ? 1.0 : 0.0)
+    NUMBER_OP(OP_OR_NUM, (lv != 0 || rv != 0) ? 1.0 : 0.0)
+#undef NUMBER_OP
+
+    // ゼロ除算のエラー報告は共通の意味論に任せる
+    CASE(OP_DIV_NUM) {
+        EvalResult* left = &r[ip->b];
+        EvalResult* right = &r[ip->c];
+        if (left->type != RESULT_NUMBER || right->type != RESULT_NUMBER) DEOPTIMIZE(OP_DIV);
+        if (right->value.number == 0) r[ip->a] = apply_binary_op(vm->interpreter->allocator, &vm->interpreter->errors, TOKEN_DIVIDE, *left, *right);
+        else {
+            r[ip->a].value.number = left->value.number / right->value.number;
+            r[ip->a].type = RESULT_NUMBER;
+        }
+        NEXT();
+    }
+    CASE(OP_ADD_STR)
+        if (r[ip->b].type == RESULT_NUMBER || r[ip->c].type == RESULT_NUMBER) DEOPTIMIZE(OP_ADD);
+        binary_concat_strings(vm, r, ip);
+        NEXT();
+    CASE(OP_EQ_STR)
+        if (r[ip->b].type == RESULT_NUMBER || r[ip->c].type == RESULT_NUMBER) DEOPTIMIZE(OP_EQ);
+        binary_string_equality(r, ip, 0);
+        NEXT();
+    CASE(OP_NEQ_STR)
+        if (r[ip->b].type == RESULT_NUMBER || r[ip->c].type == RESULT_NUMBER) DEOPTIMIZE(OP_NEQ);
+        binary_string_equality(r, ip, 1);
+        NEXT();
+#undef DEOPTIMIZE
+
+#define UNARY_OP(op)                                                         \
+    CASE(op) {                                                               \
+        EvalResult operand = take_register(&r[ip->b]);                       \
+        r[ip->a] = apply_unary_op(&vm->interpreter->errors, opcode_to_operator(op), operand); \
+        NEXT();                                                              \
+    }
+    UNARY_OP(OP_POS)
+    UNARY_OP(OP_NEG)
+    UNARY_OP(OP_NOT)
+#undef UNARY_OP
+
+    CASE(OP_WRITE) {
+        EvalResult value = take_register(&r[ip->a]);
+        write_result(vm->interpreter, value);
+        release_result(value);
+        NEXT();
+    }
+    CASE(OP_NUM_WRITE)
+        write_variable_slot(vm->interpreter, (int)ip->b);
+        NEXT();
+    CASE(OP_DISCARD)
+        release_result(take_register(&r[ip->a]));
+        NEXT();
+    CASE(OP_JUMP)
+        ip = code + ip->b;
+        DISPATCH();
+    CASE(OP_JUMP_IF_FALSE) {
+        EvalResult value = take_register(&r[ip->a]);
+        int is_true = result_is_truthy(value);
+        release_result(value);
+        if (!is_true) { ip = code + ip->b; DISPATCH(); }
+        NEXT();
+    }
+    CASE(OP_DEFINE_CATEGORY)
+        define_category_slot(vm->interpreter, (int)ip->b, NULL, 0, function->program->functions[ip->c]);
+        NEXT();
+    CASE(OP_RUN) {
+        Category* category = &vm->interpreter->categories[ip->b];
+        if (category->function) {
+            if (vm->interpreter->profile) profile_enter(vm->interpreter->profile, (int)ip->b);
+            vm_execute(vm, category->function);
+            if (vm->interpreter->profile) profile_leave(vm->interpreter->profile);
+            r = vm->registers + base; // 再帰でレジスタ領域が移動している可能性がある
+        } else {
+            run_category_slot(vm->interpreter, (int)ip->b);
+        }
+        NEXT();
+    }
+    CASE(OP_CALL)
+        execute_external_code(vm->interpreter, result_chars(&k[ip->b]), result_chars(&k[ip->c]));
+        NEXT();
+    CASE(OP_CALL_VALUE)
+        r[ip->a] = evaluate_external_code(vm->interpreter, result_chars(&k[ip->b]), result_chars(&k[ip->c]));
+        NEXT();
+    CASE(OP_PRUN)
+        parallel_run_constants(vm, k, ip);
+        NEXT();
+    CASE(OP_STMT)
+        STATS_INC(statements);
+        if (vm->interpreter->profile) profile_statement(vm->interpreter->profile, (int)ip->b);
+        NEXT();
+    CASE(OP_RETURN)
+        goto done;
+
+#if !USE_COMPUTED_GOTO
+        default:
+            output_error(&vm->interpreter->errors, "Runtime error: Unknown opcode %d\n", ip->op);
+            goto done;
+    }
+#endif
+#undef CASE
+#undef DISPATCH
+#undef NEXT
+
+done:
+    for (int i = 0; i < function->register_count; i++)
+        release_result(r[i]);
+    vm->register_top = base;
+}
+
+void vm_run(VM* vm, Program* program) {
+    if (!program) return;
+    vm_execute(vm, program->functions[0]);
+}
+
+void vm_run_category(VM* vm, int slot) {
+    Category* category = &vm->interpreter->categories[slot];
+    if (category->function) {
+        if (vm->interpreter->profile) profile_enter(vm->interpreter->profile, slot);
+        vm_execute(vm, category->function);
+        if (vm->interpreter->profile) profile_leave(vm->interpreter->profile);
+    } else {
+        run_category_slot(vm->interpreter, slot);
+    }
+}
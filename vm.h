@@ -0,0 +1,20 @@
+#ifndef VM_H
+#define VM_H
+
+#include "compiler.h"
+#include "interpreter.h"
+
+// レジスタVM。変数表とカテゴリは Interpreter のものを共有する
+typedef struct {
+    Interpreter* interpreter;
+    EvalResult* registers;
+    int register_top;
+    int register_capacity;
+} VM;
+
+VM* vm_create(Interpreter* interpreter);
+void vm_free(VM* vm);
+void vm_run(VM* vm, Program* program);
+void vm_run_category(VM* vm, int slot);     // run と同じ（カテゴリは定義済みであること）
+
+#endif